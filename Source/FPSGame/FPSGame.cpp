@@ -4,4 +4,12 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, FPSGame, "FPSGame" );
+
+CSV_DEFINE_CATEGORY(FPSGame, true);
+
+DEFINE_LOG_CATEGORY(LogFPSGame);
+DEFINE_LOG_CATEGORY(LogFPSWeapons);
+DEFINE_LOG_CATEGORY(LogFPSAI);
+DEFINE_LOG_CATEGORY(LogFPSPhysics);
+DEFINE_LOG_CATEGORY(LogFPSObjective);
  
\ No newline at end of file
@@ -3,3 +3,59 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_STATS_GROUP(TEXT("FPSGame"), STATGROUP_FPSGame, STATCAT_Advanced);
+
+CSV_DECLARE_CATEGORY_EXTERN(FPSGame);
+
+/** Times the enclosing scope for stat FPSGame, Insights (cpu channel) and the FPSGame CSV category, Stat comes from DECLARE_CYCLE_STAT */
+#define FPS_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat); \
+	CSV_SCOPED_TIMING_STAT(FPSGame, Stat)
+
+/** Sets a per-frame counter for stat FPSGame and the FPSGame CSV category, Stat comes from DECLARE_DWORD_COUNTER_STAT */
+#define FPS_SET_COUNTER(Stat, Value) \
+	do \
+	{ \
+		SET_DWORD_STAT(Stat, Value); \
+		CSV_CUSTOM_STAT(FPSGame, Stat, (int32)(Value), ECsvCustomStatOp::Set); \
+	} while (0)
+
+/** Test and Shipping builds compile out everything below Warning, the other builds keep it all and filter at runtime */
+#if UE_BUILD_SHIPPING || UE_BUILD_TEST
+#define FPS_LOG_COMPILE_VERBOSITY Warning
+#else
+#define FPS_LOG_COMPILE_VERBOSITY All
+#endif
+
+DECLARE_LOG_CATEGORY_EXTERN(LogFPSGame, Log, FPS_LOG_COMPILE_VERBOSITY);
+DECLARE_LOG_CATEGORY_EXTERN(LogFPSWeapons, Log, FPS_LOG_COMPILE_VERBOSITY);
+DECLARE_LOG_CATEGORY_EXTERN(LogFPSAI, Log, FPS_LOG_COMPILE_VERBOSITY);
+DECLARE_LOG_CATEGORY_EXTERN(LogFPSPhysics, Log, FPS_LOG_COMPILE_VERBOSITY);
+DECLARE_LOG_CATEGORY_EXTERN(LogFPSObjective, Log, FPS_LOG_COMPILE_VERBOSITY);
+
+/**
+ * UE_LOG for per-frame and per-event messages, logged at most once every Interval seconds from each call site.
+ * Costs nothing where the verbosity is compiled out, and only a branch where it is filtered at runtime.
+ */
+#define FPS_LOG_THROTTLED(CategoryName, Verbosity, Interval, Format, ...) \
+	do \
+	{ \
+		if (UE_LOG_ACTIVE(CategoryName, Verbosity)) \
+		{ \
+			static double FPSLogNextTime = 0.0; \
+			const double FPSLogNow = FPlatformTime::Seconds(); \
+			if (FPSLogNow >= FPSLogNextTime) \
+			{ \
+				FPSLogNextTime = FPSLogNow + (Interval); \
+				UE_LOG(CategoryName, Verbosity, Format, ##__VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+/** Weapon traces against simple collision. Character capsules ignore it, the physics asset bodies of their meshes block it and are hit rewound by the lag compensation */
+#define COLLISION_HITBOX ECC_GameTraceChannel2
@@ -1,21 +1,45 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FPSAIGuard.h"
+#include "FPSGame.h"
 #include "Perception/PawnSensingComponent.h"
-#include "DrawDebugHelpers.h"
+#include "FPSDebugDrawSubsystem.h"
 #include "TimerManager.h"
 #include "FPSGameMode.h"
 #include "AIController.h"
+#include "GameFramework/CharacterMovementComponent.h"
 #include "Engine/World.h"
 #include "FPSCharacter.h"
 #include "Net/UnrealNetwork.h"
-#include "EngineUtils.h"
+#include "FPSPatrolRoute.h"
+#include "NavigationData.h"
+#include "FPSSignificanceSubsystem.h"
+#include "FPSLagCompensationSubsystem.h"
+#include "FPSPerceptionSubsystem.h"
+#include "FPSGuardCrowdSubsystem.h"
+#include "FPSGuardThinkSubsystem.h"
+
+/** Seconds between checks whether a guard that was moved came to rest */
+static const float MovementSettleInterval = 0.25f;
+
+/** Below this speed a guard that isn't falling counts as at rest */
+static const float MovementSettleSpeed = 10.0f;
+
+DECLARE_CYCLE_STAT(TEXT("AI Guard OnPawnSeen"), STAT_FPSAIGuardOnPawnSeen, STATGROUP_FPSGame);
+DECLARE_CYCLE_STAT(TEXT("AI Guard OnNoiseHeard"), STAT_FPSAIGuardOnNoiseHeard, STATGROUP_FPSGame);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Guards"), STAT_FPSGuards, STATGROUP_FPSGame);
 
 // Sets default values
 AFPSAIGuard::AFPSAIGuard()
 {
- 	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Patrols advance when the controller's moves complete, nothing to do every frame
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Standing guards only change with their state, which flushes them, placed ones start out dormant like the level copy
+	NetDormancy = DORM_Initial;
+
+	// Guards promoted from the crowd are spawned and need their controller as much as placed ones
+	AutoPossessAI = EAutoPossessAI::PlacedInWorldOrSpawned;
 
 	PawnSensingComp = CreateDefaultSubobject<UPawnSensingComponent>(TEXT("PawnSensingComp"));
 	PawnSensingComp->OnSeePawn.AddDynamic(this, &AFPSAIGuard::OnPawnSeen);
@@ -23,129 +47,298 @@ AFPSAIGuard::AFPSAIGuard()
 
 	GuardState = EAIState::Idle;
 
-	PatrolPointNumber = 0;
+	bSimulateInCrowd = true;
+
+	SuspicionDuration = 3.0f;
+	SuspiciousUntil = 0.0f;
+	bPendingNoise = false;
+
+	PatrolAcceptanceRadius = 90.0f;
+	PatrolPointIndex = INDEX_NONE;
+
+	bInCrowd = false;
+
+	MediumSignificanceInterval = 0.2f;
+	LowSignificanceInterval = 1.0f;
 }
 
 // Called when the game starts or when spawned
 void AFPSAIGuard::BeginPlay()
 {
 	Super::BeginPlay();
+
+	INC_DWORD_STAT(STAT_FPSGuards);
 	
 	OriginalRotation = GetActorRotation();
-	
-	if (bPatrol)
+
+	DefaultSensingInterval = PawnSensingComp->SensingInterval;
+
+	RegisterWithSubsystems();
+
+	StartPatrol();
+
+	UpdateNetDormancy();
+}
+
+void AFPSAIGuard::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterFromSubsystems();
+
+	DEC_DWORD_STAT(STAT_FPSGuards);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AFPSAIGuard::RegisterWithSubsystems()
+{
+	// Sight and hearing are batched with every other guard's, the component only holds their settings and delegates.
+	// Registered first so the significance set on registration applies to it as well
+	UFPSPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UFPSPerceptionSubsystem>();
+	if (HasAuthority() && Perception)
 	{
-		for (TActorIterator<AActor> It(GetWorld()); It; ++It)
-		{
-			if (It->GetName().Contains("TargetPoint"))
-			{
-				PatrolPoints.Add(*It);
-			}
-		}
+		Perception->RegisterObserver(PawnSensingComp);
+	}
 
-		MoveToNextPatrolPoint();
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Register(this);
+	}
+
+	// Guards can be shot as well, keep their hitboxes for lag compensation
+	UFPSLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UFPSLagCompensationSubsystem>();
+	if (HasAuthority() && LagCompensation)
+	{
+		LagCompensation->Register(this);
 	}
 }
 
-// Called every frame
-void AFPSAIGuard::Tick(float DeltaTime)
+void AFPSAIGuard::UnregisterFromSubsystems()
 {
-	Super::Tick(DeltaTime);
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Unregister(this);
+	}
 
-	// Patrol Goal Checks
-	if (CurrentPatrolPoint)
+	UFPSLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UFPSLagCompensationSubsystem>();
+	if (LagCompensation)
 	{
-		FVector Delta = GetActorLocation() - CurrentPatrolPoint->GetActorLocation();
-		float DistanceToGoal = Delta.Size();
+		LagCompensation->Unregister(this);
+	}
 
-		// Check if we are within 50 units of our goal, if so - pick a new patrol point
-		if (DistanceToGoal < 90)
-		{
-			MoveToNextPatrolPoint();
-		}
-	} 
+	UFPSPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UFPSPerceptionSubsystem>();
+	if (Perception)
+	{
+		Perception->UnregisterObserver(PawnSensingComp);
+	}
 }
 
-void AFPSAIGuard::OnPawnSeen(APawn* SeenPawn)
+void AFPSAIGuard::OnSignificanceChanged(EFPSSignificance NewSignificance)
 {
-	if (SeenPawn == nullptr)
+	// Perception slows down with distance and stops when nobody is anywhere near
+	switch (NewSignificance)
 	{
-		return;
+	case EFPSSignificance::High:
+		PawnSensingComp->SetSensingInterval(DefaultSensingInterval);
+		break;
+	case EFPSSignificance::Medium:
+		PawnSensingComp->SetSensingInterval(FMath::Max(DefaultSensingInterval, MediumSignificanceInterval));
+		break;
+	case EFPSSignificance::Low:
+		PawnSensingComp->SetSensingInterval(FMath::Max(DefaultSensingInterval, LowSignificanceInterval));
+		break;
+	default:
+		break;
 	}
 
-	DrawDebugSphere(GetWorld(), SeenPawn->GetActorLocation(), 32.0f, 12, FColor::Red, false, 10.0f);
+	const bool bDormant = (NewSignificance == EFPSSignificance::Dormant);
+	PawnSensingComp->SetSensingUpdatesEnabled(!bDormant);
 
-	AFPSGameMode* GM = Cast<AFPSGameMode>(GetWorld()->GetAuthGameMode());
-	if (GM)
+	UFPSPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UFPSPerceptionSubsystem>();
+	if (Perception)
 	{
-		GM->CompleteMission(SeenPawn, false);
+		// Stop looking but keep listening, a noise nearby still gets through to OnNoiseHeard
+		Perception->SetObserverSightEnabled(PawnSensingComp, !bDormant);
+	}
+
+	// Nobody near, the crowd takes us over once we are idle
+	UFPSGuardCrowdSubsystem* Crowd = GetWorld()->GetSubsystem<UFPSGuardCrowdSubsystem>();
+	if (HasAuthority() && Crowd)
+	{
+		if (bDormant)
+		{
+			Crowd->QueueDemotion(this);
+		}
+		else
+		{
+			Crowd->CancelDemotion(this);
+		}
 	}
+}
+
+bool AFPSAIGuard::CanJoinCrowd() const
+{
+	return bSimulateInCrowd && GuardState == EAIState::Idle && !PendingSeenPawn.IsValid() && !bPendingNoise;
+}
 
-	// AFPSCharacter* Character = Cast<AFPSCharacter>(SeenPawn);
-	// if (Character)
-	// {
-	// 	Character->Die();
-	// }
+void AFPSAIGuard::SetPatrolStart(AFPSPatrolRoute* Route, int32 PointIndex)
+{
+	bPatrol = (Route != nullptr);
+	PatrolRoute = Route;
+	PatrolPointIndex = Route ? PointIndex : INDEX_NONE;
+}
 
-	//GetWorldTimerManager().ClearTimer(TimerHandle_ResetOrientation);
-	//GetWorldTimerManager().SetTimer(TimerHandle_ResetOrientation, this, &AFPSAIGuard::ResetOrientation, 3.0f);
+void AFPSAIGuard::EnterCrowd()
+{
+	bInCrowd = true;
 
-	SetGuardState(EAIState::Alerted);
+	// Out of sight, hearing and hit traces, and the component doesn't go back to sensing on its own
+	UnregisterFromSubsystems();
+	PawnSensingComp->SetSensingUpdatesEnabled(false);
 
-	// Stop Movement if Patrolling
 	AAIController* AIController = Cast<AAIController>(GetController());
 	if (AIController)
 	{
 		AIController->StopMovement();
+		AIController->SetActorTickEnabled(false);
 	}
+
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->SetComponentTickEnabled(false);
+	GetMesh()->SetComponentTickEnabled(false);
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+
+	// Clients hide their copy too, then nothing changes until we leave
+	FlushNetDormancy();
+	UpdateNetDormancy();
 }
 
-void AFPSAIGuard::OnNoiseHeard(APawn* NoiseInstigator, const FVector& Location, float Volume)
+void AFPSAIGuard::LeaveCrowd(const FVector& Location, const FRotator& Rotation, AFPSPatrolRoute* Route, int32 PointIndex)
 {
-	if (GuardState == EAIState::Alerted)
+	bInCrowd = false;
+
+	SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	GetMesh()->SetComponentTickEnabled(true);
+	GetCharacterMovement()->SetComponentTickEnabled(true);
+
+	AAIController* AIController = Cast<AAIController>(GetController());
+	if (AIController)
+	{
+		AIController->SetActorTickEnabled(true);
+	}
+
+	RegisterWithSubsystems();
+	PawnSensingComp->SetSensingUpdatesEnabled(true);
+
+	SetPatrolStart(Route, PointIndex);
+	StartPatrol();
+
+	// Clients get the new location and see us again
+	FlushNetDormancy();
+	UpdateNetDormancy();
+}
+
+void AFPSAIGuard::OnPawnSeen(APawn* SeenPawn)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSAIGuardOnPawnSeen);
+
+	if (SeenPawn == nullptr)
 	{
 		return;
 	}
 
-	DrawDebugSphere(GetWorld(), Location, 32.0f, 12, FColor::Green, false, 10.0f, 0.0f, 1.0f);
+	FPS_DEBUG_SPHERE(GetWorld(), EFPSDebugCategory::AI, SeenPawn->GetActorLocation(), 32.0f, 12, FColor::Red, 10.0f, 0.0f);
 
-	FVector Direction = Location - GetActorLocation();
-	Direction.Normalize();
+	// Reacted to when the guards think at the end of the frame
+	PendingSeenPawn = SeenPawn;
+	WakeUp();
+}
 
-	FRotator NewLookAt = FRotationMatrix::MakeFromX(Direction).Rotator();
-	NewLookAt.Pitch = 0.0f;
-	NewLookAt.Roll = 0.0f;
+void AFPSAIGuard::OnNoiseHeard(APawn* NoiseInstigator, const FVector& Location, float Volume)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSAIGuardOnNoiseHeard);
 
-	SetActorRotation(NewLookAt);
+	if (GuardState == EAIState::Alerted)
+	{
+		return;
+	}
 
-	GetWorldTimerManager().ClearTimer(TimerHandle_ResetOrientation);
-	GetWorldTimerManager().SetTimer(TimerHandle_ResetOrientation, this, &AFPSAIGuard::ResetOrientation, 3.0f);
+	FPS_DEBUG_SPHERE(GetWorld(), EFPSDebugCategory::AI, Location, 32.0f, 12, FColor::Green, 10.0f, 1.0f);
 
-	SetGuardState(EAIState::Suspicious);
+	bPendingNoise = true;
+	PendingNoiseLocation = Location;
+	WakeUp();
+}
 
-	// Stop Movement if Patrolling
-	AAIController* AIController = Cast<AAIController>(GetController());
-	if (AIController)
+void AFPSAIGuard::WakeUp()
+{
+	UFPSGuardThinkSubsystem* Think = GetWorld()->GetSubsystem<UFPSGuardThinkSubsystem>();
+	if (Think)
 	{
-		AIController->StopMovement();
+		Think->Wake(this);
 	}
 }
 
-void AFPSAIGuard::ResetOrientation()
+void AFPSAIGuard::GetThinkInput(FFPSGuardThinkInput& OutInput) const
+{
+	OutInput.State = GuardState;
+	OutInput.Location = GetActorLocation();
+	OutInput.OriginalRotation = OriginalRotation;
+	OutInput.bSawPawn = PendingSeenPawn.IsValid();
+	OutInput.bHeardNoise = bPendingNoise;
+	OutInput.NoiseLocation = PendingNoiseLocation;
+	OutInput.SuspiciousUntil = SuspiciousUntil;
+	OutInput.SuspicionDuration = SuspicionDuration;
+}
+
+void AFPSAIGuard::CommitThink(const FFPSGuardThinkAction& Action)
 {
-	/* if (GuardState == EAIState::Alerted)
+	APawn* SeenPawn = PendingSeenPawn.Get();
+	PendingSeenPawn = nullptr;
+	bPendingNoise = false;
+
+	if (Action.bReportSpotted && SeenPawn)
 	{
-		return;
-	} */
+		AFPSGameMode* GM = Cast<AFPSGameMode>(GetWorld()->GetAuthGameMode());
+		if (GM)
+		{
+			GM->CompleteMission(SeenPawn, false);
+		}
+
+		// AFPSCharacter* Character = Cast<AFPSCharacter>(SeenPawn);
+		// if (Character)
+		// {
+		// 	Character->Die();
+		// }
+	}
+
+	// Turning towards a second noise leaves the state as it was, send the rotation anyway
+	if (Action.bSetRotation && SetActorRotation(Action.Rotation))
+	{
+		FlushNetDormancy();
+	}
+
+	SuspiciousUntil = Action.SuspiciousUntil;
 
-	SetActorRotation(OriginalRotation);
+	SetGuardState(Action.NewState);
 
-	SetGuardState(EAIState::Idle);
+	// Stop Movement if Patrolling
+	AAIController* AIController = Cast<AAIController>(GetController());
+	if (Action.bStopMovement && AIController)
+	{
+		AIController->StopMovement();
+	}
 
-	// Stopped investigating...if we are a patrolling pawn, pick a new patrol point to move to
-	if (bPatrol)
+	if (Action.bResumePatrol && PatrolPointIndex != INDEX_NONE)
 	{
-		MoveToNextPatrolPoint();
+		ResumePatrol();
 	}
 }
 
@@ -161,30 +354,155 @@ void AFPSAIGuard::SetGuardState(EAIState NewState)
 		return;
 	}
 
+	UE_LOG(LogFPSAI, Verbose, TEXT("%s changed state from %d to %d"), *GetName(), (int32)GuardState, (int32)NewState);
+
 	GuardState = NewState;
 	OnRep_GuardState();
+
+	// Send the new state even when dormant
+	FlushNetDormancy();
+	UpdateNetDormancy();
+}
+
+void AFPSAIGuard::UpdateNetDormancy()
+{
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	// Walking a patrol or being moved replicates movement every update, anything else only changes with the state
+	const bool bWalking = (!bInCrowd && GuardState == EAIState::Idle && PatrolPointIndex != INDEX_NONE && PatrolRoute && PatrolRoute->GetNumPoints() > 1);
+	const bool bMoved = GetWorldTimerManager().IsTimerActive(MovementSettledTimerHandle);
+	const ENetDormancy NewDormancy = (bWalking || bMoved) ? DORM_Awake : DORM_DormantAll;
+
+	// Placed guards that never moved or changed state have nothing clients don't already know
+	if (NetDormancy == DORM_Initial && IsNetStartupActor() && NewDormancy == DORM_DormantAll)
+	{
+		return;
+	}
+
+	SetNetDormancy(NewDormancy);
+}
+
+void AFPSAIGuard::WakeForMovement()
+{
+	if (!HasAuthority() || bInCrowd)
+	{
+		return;
+	}
+
+	// Dormant clients would keep us where we stood, whatever moves us now
+	if (!GetWorldTimerManager().IsTimerActive(MovementSettledTimerHandle))
+	{
+		GetWorldTimerManager().SetTimer(MovementSettledTimerHandle, this, &AFPSAIGuard::CheckMovementSettled, MovementSettleInterval, true);
+	}
+
+	SetNetDormancy(DORM_Awake);
+}
+
+void AFPSAIGuard::CheckMovementSettled()
+{
+	if (GetCharacterMovement()->IsFalling() || GetVelocity().SizeSquared() > FMath::Square(MovementSettleSpeed))
+	{
+		return;
+	}
+
+	GetWorldTimerManager().ClearTimer(MovementSettledTimerHandle);
+	UpdateNetDormancy();
+}
+
+void AFPSAIGuard::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+
+	AAIController* AIController = Cast<AAIController>(NewController);
+	if (AIController)
+	{
+		AIController->ReceiveMoveCompleted.AddUniqueDynamic(this, &AFPSAIGuard::OnMoveCompleted);
+	}
+}
+
+void AFPSAIGuard::UnPossessed()
+{
+	AAIController* AIController = Cast<AAIController>(GetController());
+	if (AIController)
+	{
+		AIController->ReceiveMoveCompleted.RemoveDynamic(this, &AFPSAIGuard::OnMoveCompleted);
+	}
+
+	Super::UnPossessed();
+}
+
+void AFPSAIGuard::OnMoveCompleted(FAIRequestID RequestID, EPathFollowingResult::Type Result)
+{
+	// Moves stopped by sensing are resumed once suspicion wears off
+	if (RequestID == PatrolMoveRequestId && Result == EPathFollowingResult::Success)
+	{
+		MoveToNextPatrolPoint();
+	}
 }
 
 void AFPSAIGuard::MoveToNextPatrolPoint()
 {
-	for(PatrolPointNumber; PatrolPoints.Num(); PatrolPointNumber++)
+	// A single point route has nowhere to go, advancing would complete the move straight away and ask for another one
+	if (PatrolPointIndex == INDEX_NONE || PatrolRoute->GetNumPoints() < 2)
 	{
-		if (PatrolPoints[PatrolPointNumber] != CurrentPatrolPoint)
+		return;
+	}
+
+	const int32 FromIndex = PatrolPointIndex;
+	PatrolPointIndex = PatrolRoute->GetNextPointIndex(PatrolPointIndex);
+
+	AAIController* AIController = Cast<AAIController>(GetController());
+	if (AIController)
+	{
+		// The route already holds the path, no navmesh query needed
+		TArray<FVector> PathPoints = PatrolRoute->GetPathFromPoint(FromIndex);
+		if (PathPoints.Num() < 2)
 		{
-			CurrentPatrolPoint = PatrolPoints[PatrolPointNumber];
+			// Nothing baked to follow, let the navmesh find the way
+			AIController->MoveToLocation(PatrolRoute->GetPointLocation(PatrolPointIndex), PatrolAcceptanceRadius);
+			PatrolMoveRequestId = AIController->GetCurrentMoveRequestID();
+			return;
+		}
 
-			AAIController* AIController = Cast<AAIController>(GetController());
-			if (AIController)
-			{
-				AIController->MoveTo(CurrentPatrolPoint);
-			}
+		FAIMoveRequest MoveRequest(PatrolRoute->GetPointLocation(PatrolPointIndex));
+		MoveRequest.SetAcceptanceRadius(PatrolAcceptanceRadius);
 
-			if (PatrolPointNumber >= PatrolPoints.Num() - 1)
-			{
-				PatrolPointNumber = 0;
-			}
+		FNavPathSharedPtr Path = MakeShareable(new FNavigationPath(PathPoints));
+		PatrolMoveRequestId = AIController->RequestMove(MoveRequest, Path);
+	}
+}
 
-			break;
+void AFPSAIGuard::StartPatrol()
+{
+	if (bPatrol && PatrolRoute && PatrolRoute->GetNumPoints() > 0)
+	{
+		// From the start of the route, unless we come back from the crowd halfway along it
+		PatrolPointIndex = FMath::Clamp(PatrolPointIndex, 0, PatrolRoute->GetNumPoints() - 1);
+		ResumePatrol();
+	}
+}
+
+void AFPSAIGuard::ResumePatrol()
+{
+	AAIController* AIController = Cast<AAIController>(GetController());
+	if (AIController)
+	{
+		// Already there, the completion was broadcast before we could know the request
+		if (AIController->MoveToLocation(PatrolRoute->GetPointLocation(PatrolPointIndex), PatrolAcceptanceRadius) == EPathFollowingRequestResult::AlreadyAtGoal)
+		{
+			MoveToNextPatrolPoint();
+			return;
+		}
+
+		PatrolMoveRequestId = AIController->GetCurrentMoveRequestID();
+
+		// Walking back to a single point route isn't a patrol, stay awake until we get there
+		if (PatrolRoute->GetNumPoints() < 2)
+		{
+			WakeForMovement();
 		}
 	}
 }
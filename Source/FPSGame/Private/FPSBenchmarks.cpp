@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGame.h"
+#include "FPSLagCompensationSubsystem.h"
+#include "Components/SphereComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+// Console commands that time the scene queries behind the collision setup, for development builds only
+#if !UE_BUILD_SHIPPING
+
+static void RunHitscanBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+	if (PC == nullptr)
+	{
+		return;
+	}
+
+	const int32 NumTraces = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	// Same rays for both channels, spread in a cone in front of the player
+	FRandomStream Stream(NumTraces);
+	TArray<FVector> Ends;
+	Ends.Reserve(NumTraces);
+	for (int32 i = 0; i < NumTraces; i++)
+	{
+		Ends.Add(ViewLocation + Stream.VRandCone(ViewRotation.Vector(), FMath::DegreesToRadians(30.0f)) * 1500.0f);
+	}
+
+	FHitResult Hit;
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSHitscanBenchmark), true, PC->GetPawn());
+
+	// How weapons traced before, per triangle on Visibility with the character meshes in the scene
+	double StartTime = FPlatformTime::Seconds();
+	int32 NumHits = 0;
+	for (const FVector& End : Ends)
+	{
+		NumHits += World->LineTraceSingleByChannel(Hit, ViewLocation, End, ECC_Visibility, QueryParams) ? 1 : 0;
+	}
+	const double VisibilityTime = FPlatformTime::Seconds() - StartTime;
+	const int32 VisibilityHits = NumHits;
+
+	// How a shot resolves now, simple collision on Hitbox without the characters, then their rewound physics asset bodies
+	UFPSLagCompensationSubsystem* LagCompensation = World->GetSubsystem<UFPSLagCompensationSubsystem>();
+	QueryParams.bTraceComplex = false;
+	if (LagCompensation)
+	{
+		LagCompensation->AddIgnoredCharacters(QueryParams);
+	}
+
+	const float Now = World->GetTimeSeconds();
+
+	StartTime = FPlatformTime::Seconds();
+	NumHits = 0;
+	for (const FVector& End : Ends)
+	{
+		const bool bWorldHit = World->LineTraceSingleByChannel(Hit, ViewLocation, End, COLLISION_HITBOX, QueryParams);
+		const bool bHitboxHit = LagCompensation && LagCompensation->TraceHitboxes(ViewLocation, End, Now, PC->GetPawn(), bWorldHit ? Hit.Distance : MAX_flt, Hit);
+		NumHits += (bWorldHit || bHitboxHit) ? 1 : 0;
+	}
+	const double HitboxTime = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogFPSWeapons, Log, TEXT("Hitscan benchmark, %d traces: Visibility complex %.2f us/trace (%d hits), Hitbox simple with rewound bodies %.2f us/trace (%d hits)"),
+		NumTraces, VisibilityTime * 1000000.0 / NumTraces, VisibilityHits, HitboxTime * 1000000.0 / NumTraces, NumHits);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HitscanBenchmarkCommand(
+	TEXT("fps.Hitscan.Benchmark"),
+	TEXT("Times N (default 1000) weapon traces from the local player's view, complex on Visibility against the server's Hitbox trace and rewound physics asset bodies. Run it on the server or standalone."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunHitscanBenchmark));
+
+static void RunGrenadeFlightBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+	if (PC == nullptr)
+	{
+		return;
+	}
+
+	const int32 NumGrenades = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+	const float OuterRadius = Args.Num() > 1 ? FMath::Max(1.0f, FCString::Atof(*Args[1])) : 1000.0f;
+	const int32 NumSteps = 60;
+	const float StepTime = 1.0f / 60.0f;
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	// Grenades spread in front of the player, thrown the way the player looks
+	FRandomStream Stream(NumGrenades);
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	TArray<USphereComponent*> Grenades;
+	TArray<FVector> StartLocations;
+	for (int32 i = 0; i < NumGrenades; i++)
+	{
+		AActor* Grenade = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (Grenade == nullptr)
+		{
+			continue;
+		}
+
+		USphereComponent* Collision = NewObject<USphereComponent>(Grenade);
+		Collision->InitSphereRadius(5.0f);
+		Collision->SetCollisionProfileName("Projectile");
+		Grenade->SetRootComponent(Collision);
+		Collision->RegisterComponent();
+
+		const FVector Location = ViewLocation + Stream.VRandCone(ViewRotation.Vector(), FMath::DegreesToRadians(30.0f)) * Stream.FRandRange(200.0f, 1500.0f);
+		Collision->SetWorldLocation(Location);
+
+		Grenades.Add(Collision);
+		StartLocations.Add(Location);
+	}
+
+	// One frame of flight per step, swept like UProjectileMovementComponent moves them
+	const FVector StepDelta = ViewRotation.Vector() * 1500.0f * StepTime;
+	auto TimeFlight = [&]()
+	{
+		for (int32 i = 0; i < Grenades.Num(); i++)
+		{
+			Grenades[i]->SetWorldLocation(StartLocations[i], false, nullptr, ETeleportType::TeleportPhysics);
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			for (USphereComponent* Grenade : Grenades)
+			{
+				Grenade->MoveComponent(StepDelta, Grenade->GetComponentQuat(), true);
+			}
+		}
+		return FPlatformTime::Seconds() - StartTime;
+	};
+
+	const double FlightTime = TimeFlight();
+
+	// The outer sphere grenades used to carry, tracking overlaps with everything they pass
+	for (USphereComponent* Grenade : Grenades)
+	{
+		USphereComponent* OuterSphere = NewObject<USphereComponent>(Grenade->GetOwner());
+		OuterSphere->InitSphereRadius(OuterRadius);
+		OuterSphere->SetCollisionProfileName("OverlapAll");
+		OuterSphere->SetGenerateOverlapEvents(true);
+		OuterSphere->SetupAttachment(Grenade);
+		OuterSphere->RegisterComponent();
+	}
+
+	const double OuterSphereFlightTime = TimeFlight();
+
+	for (USphereComponent* Grenade : Grenades)
+	{
+		Grenade->GetOwner()->Destroy();
+	}
+
+	const int32 NumMoves = FMath::Max(1, Grenades.Num() * NumSteps);
+	UE_LOG(LogFPSPhysics, Log, TEXT("Grenade flight benchmark, %d grenades over %d frames: %.2f us per grenade per frame, %.2f us with a %.0f outer overlap sphere"),
+		Grenades.Num(), NumSteps, FlightTime * 1000000.0 / NumMoves, OuterSphereFlightTime * 1000000.0 / NumMoves, OuterRadius);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GrenadeFlightBenchmarkCommand(
+	TEXT("fps.Grenade.Benchmark"),
+	TEXT("Times the scene queries of N (default 100) grenades in flight in front of the local player, with and without an outer overlap sphere of the given radius (default 1000)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunGrenadeFlightBenchmark));
+
+#endif // !UE_BUILD_SHIPPING
@@ -4,14 +4,15 @@
 #include "FPSBlackHole.h"
 #include "Components/StaticMeshComponent.h"
 #include "Components/SphereComponent.h"
-#include "GameFramework/CharacterMovementComponent.h"
-#include "GameFramework/Character.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSForceFieldSubsystem.h"
+#include "FPSSignificanceSubsystem.h"
 
 // Sets default values
 AFPSBlackHole::AFPSBlackHole()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// The pull is applied by the force field subsystem, no need to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	BlackHoleRadius = 1000;
 	BlackHoleForceStrength = -2000;
@@ -28,20 +29,18 @@ AFPSBlackHole::AFPSBlackHole()
 	// Bind to Event
 	InnerSphereComponent->OnComponentBeginOverlap.AddDynamic(this, &AFPSBlackHole::OverlapInnerSphere);
 
-	OuterSphereComponent = CreateDefaultSubobject<USphereComponent>(TEXT("OuterSphereComp"));
-	OuterSphereComponent->InitSphereRadius(BlackHoleRadius);
-	OuterSphereComponent->SetCollisionProfileName("OverlapAll");
-	OuterSphereComponent->SetupAttachment(MeshComp);
-
 	// Die after x seconds by default
 	InitialLifeSpan = 5.0f;
+
+	ForceFieldId = INDEX_NONE;
 }
 
 void AFPSBlackHole::OverlapInnerSphere(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
 	if (OtherActor)
 	{
-		OtherActor->Destroy();
+		// Pooled projectiles and grenades are parked instead of destroyed
+		UFPSProjectilePoolSubsystem::ReturnOrDestroy(OtherActor);
 	}
 }
 
@@ -49,43 +48,43 @@ void AFPSBlackHole::OverlapInnerSphere(UPrimitiveComponent* OverlappedComponent,
 void AFPSBlackHole::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
+	{
+		ForceFieldId = ForceFields->AddField(this, GetActorLocation(), BlackHoleRadius, BlackHoleForceStrength, ERadialImpulseFalloff::RIF_Constant);
+	}
+
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Register(this);
+	}
 }
 
-// Called every frame
-void AFPSBlackHole::Tick(float DeltaTime)
+void AFPSBlackHole::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Unregister(this);
+	}
 
-	TArray<AActor*> OverlappingActors;
-	OuterSphereComponent->GetOverlappingActors(OverlappingActors);
-	for (int32 i = 0; i < OverlappingActors.Num(); i++)
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
 	{
-		UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(OverlappingActors[i]->GetRootComponent());
-		if (PrimComp && PrimComp->IsSimulatingPhysics())
-		{
-			UE_LOG(LogTemp, Log, TEXT("Environment items overlapped with blackhole zone!!"));
-
-			// the component we are looking for! It needs to be simulating in order to apply forces.
-
-			PrimComp->AddRadialForce(GetActorLocation(), BlackHoleRadius, BlackHoleForceStrength, ERadialImpulseFalloff::RIF_Constant, true);
-		}
-
-		ACharacter* Character = Cast<ACharacter>(OverlappingActors[i]);
-		if (Character)
-		{
-			UCharacterMovementComponent* CharacterComp = Cast<UCharacterMovementComponent>(Character->GetMovementComponent());
-			if (CharacterComp)
-			{
-				UE_LOG(LogTemp, Log, TEXT("Character overlapped with blackhole zone!!"));
-
-				//CharacterComp->StopMovementImmediately();
-				//CharacterComp->DisableMovement();
-				//CharacterComp->SetComponentTickEnabled(false);
-
-				CharacterComp->AddRadialForce(GetActorLocation(), BlackHoleRadius, BlackHoleForceStrength * CharacterComp->Mass, ERadialImpulseFalloff::RIF_Constant);
-			}
-		}
+		ForceFields->RemoveField(ForceFieldId);
 	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
+void AFPSBlackHole::OnSignificanceChanged(EFPSSignificance NewSignificance)
+{
+	// Nobody is around to see the pull, stop querying and pushing until someone comes back
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
+	{
+		ForceFields->SetFieldPaused(ForceFieldId, NewSignificance == EFPSSignificance::Dormant);
+	}
+}
@@ -2,20 +2,24 @@
 
 
 #include "FPSBlackHoleGrenade.h"
+#include "FPSGame.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
 #include "Components/StaticMeshComponent.h"
-#include "DrawDebugHelpers.h"
+#include "FPSDebugDrawSubsystem.h"
 #include "Kismet/GameplayStatics.h"
-#include "GameFramework/CharacterMovementComponent.h"
-#include "GameFramework/Character.h"
 #include "TimerManager.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSForceFieldSubsystem.h"
+#include "FPSSignificanceSubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Black Hole Grenade OnExplode"), STAT_FPSBlackHoleGrenadeExplode, STATGROUP_FPSGame);
 
 // Sets default values
 AFPSBlackHoleGrenade::AFPSBlackHoleGrenade()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// The pull is applied by the force field subsystem, no need to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	GrenadeRadius = 1500;
 	GrenadeForceStrength = -3000;
@@ -24,6 +28,7 @@ AFPSBlackHoleGrenade::AFPSBlackHoleGrenade()
 	BlackHoleLifeSpan = 10;
 
 	IsExploding = false;
+	ForceFieldId = INDEX_NONE;
 
 	// Use a sphere as a simple collision representation
 	CollisionComp = CreateDefaultSubobject<USphereComponent>(TEXT("SphereComp"));
@@ -37,11 +42,6 @@ AFPSBlackHoleGrenade::AFPSBlackHoleGrenade()
 	// Set as root component
 	RootComponent = CollisionComp;
 
-	OuterSphereComponent = CreateDefaultSubobject<USphereComponent>(TEXT("OuterSphereComp"));
-	OuterSphereComponent->InitSphereRadius(GrenadeRadius);
-	OuterSphereComponent->SetCollisionProfileName("OverlapAll");
-	OuterSphereComponent->SetupAttachment(RootComponent);
-
 	// Use a ProjectileMovementComponent to govern this projectile's movement
 	GrenadeMovement = CreateDefaultSubobject<UProjectileMovementComponent>(TEXT("ProjectileComp"));
 	GrenadeMovement->UpdatedComponent = CollisionComp;
@@ -58,49 +58,82 @@ AFPSBlackHoleGrenade::AFPSBlackHoleGrenade()
 void AFPSBlackHoleGrenade::BeginPlay()
 {
 	Super::BeginPlay();
+
+	GrenadeMeshCollision = GrenadeMesh->GetCollisionEnabled();
 	
+	StartFuze();
+}
+
+void AFPSBlackHoleGrenade::StartFuze()
+{
 	/* Activate the fuze to explode the bomb after several seconds */
 	GetWorldTimerManager().SetTimer(FuzeTimerHandle, this, &AFPSBlackHoleGrenade::OnExplode, MaxFuzeTime, false);
 }
 
-// Called every frame
-void AFPSBlackHoleGrenade::Tick(float DeltaTime)
+void AFPSBlackHoleGrenade::OnAcquiredFromPool()
 {
-	Super::Tick(DeltaTime);
+	GrenadeMesh->SetVisibility(true);
+	GrenadeMesh->SetCollisionEnabled(GrenadeMeshCollision);
 
-	if (IsExploding)
+	StartFuze();
+}
+
+void AFPSBlackHoleGrenade::OnReturnedToPool()
+{
+	GetWorldTimerManager().ClearTimer(FuzeTimerHandle);
+
+	IsExploding = false;
+	RemoveForceField();
+}
+
+void AFPSBlackHoleGrenade::OnMaterialized(float RemainingFuzeTime)
+{
+	// Pick up the fuze where the batched simulation left it
+	if (RemainingFuzeTime <= 0.0f)
 	{
-		TArray<AActor*> OverlappingActors;
-		OuterSphereComponent->GetOverlappingActors(OverlappingActors);
-		for (int32 i = 0; i < OverlappingActors.Num(); i++)
-		{
-			UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(OverlappingActors[i]->GetRootComponent());
-			if (PrimComp && PrimComp->IsSimulatingPhysics())
-			{
-				UE_LOG(LogTemp, Log, TEXT("Environment items overlapped with blackhole zone!!"));
-
-				// the component we are looking for! It needs to be simulating in order to apply forces.
-
-				PrimComp->AddRadialForce(Location, GrenadeRadius, GrenadeForceStrength, ERadialImpulseFalloff::RIF_Constant, true);
-			}
-
-			ACharacter* Character = Cast<ACharacter>(OverlappingActors[i]);
-			if (Character)
-			{
-				UCharacterMovementComponent* CharacterComp = Cast<UCharacterMovementComponent>(Character->GetMovementComponent());
-				if (CharacterComp)
-				{
-					UE_LOG(LogTemp, Log, TEXT("Character overlapped with blackhole zone!!"));
-
-					//CharacterComp->StopMovementImmediately();
-					//CharacterComp->DisableMovement();
-					//CharacterComp->SetComponentTickEnabled(false);
-
-					CharacterComp->AddRadialForce(Location, GrenadeRadius, GrenadeForceStrength * CharacterComp->Mass, ERadialImpulseFalloff::RIF_Constant);
-				}
-			}
-		}
+		OnExplode();
+		return;
 	}
+
+	GetWorldTimerManager().SetTimer(FuzeTimerHandle, this, &AFPSBlackHoleGrenade::OnExplode, RemainingFuzeTime, false);
+}
+
+void AFPSBlackHoleGrenade::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	RemoveForceField();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AFPSBlackHoleGrenade::OnSignificanceChanged(EFPSSignificance NewSignificance)
+{
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
+	{
+		ForceFields->SetFieldPaused(ForceFieldId, NewSignificance == EFPSSignificance::Dormant);
+	}
+}
+
+void AFPSBlackHoleGrenade::RemoveForceField()
+{
+	if (ForceFieldId == INDEX_NONE)
+	{
+		return;
+	}
+
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Unregister(this);
+	}
+
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
+	{
+		ForceFields->RemoveField(ForceFieldId);
+	}
+
+	ForceFieldId = INDEX_NONE;
 }
 
 void AFPSBlackHoleGrenade::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
@@ -114,18 +147,36 @@ void AFPSBlackHoleGrenade::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActo
 
 void AFPSBlackHoleGrenade::OnExplode()
 {
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSBlackHoleGrenadeExplode);
+
 	Location = GetActorLocation();
 	Location.Z += 500;
 
-	FCollisionShape MyColSphere = FCollisionShape::MakeSphere(GrenadeRadius);
+	FPS_DEBUG_SPHERE(GetWorld(), EFPSDebugCategory::Explosions, Location, GrenadeRadius, 16, FColor::Red, BlackHoleLifeSpan, 1.f);
 
-	DrawDebugSphere(GetWorld(), Location, MyColSphere.GetSphereRadius(), 50, FColor::Red, false, BlackHoleLifeSpan, 0, 1);
-
-	GrenadeMesh->DestroyComponent();
-	GrenadeMovement->DestroyComponent();
+	// Hide instead of destroying the components so the grenade can be reused from the pool
+	GrenadeMesh->SetVisibility(false);
+	GrenadeMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	GrenadeMovement->StopMovementImmediately();
+	GrenadeMovement->Deactivate();
 	
 	IsExploding = true;
 
+	UFPSForceFieldSubsystem* ForceFields = GetWorld()->GetSubsystem<UFPSForceFieldSubsystem>();
+	if (ForceFields)
+	{
+		// Bodies are found around the grenade and pulled up towards the black hole above it
+		ForceFieldId = ForceFields->AddField(this, Location, GrenadeRadius, GrenadeForceStrength, ERadialImpulseFalloff::RIF_Constant);
+		ForceFields->SetFieldQueryCenter(ForceFieldId, GetActorLocation());
+	}
+
+	// Only the active black hole is scored, the grenade does no work of its own while the fuze burns
+	UFPSSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UFPSSignificanceSubsystem>();
+	if (Significance)
+	{
+		Significance->Register(this);
+	}
+
 	if (ActivateGrenadeEffect)
 		UGameplayStatics::SpawnEmitterAtLocation(this, ActivateGrenadeEffect, GetActorLocation());
 	if (ActivateGrenadeSound)
@@ -141,5 +192,7 @@ void AFPSBlackHoleGrenade::EndBlackHole()
 {
 	GetWorldTimerManager().ClearAllTimersForObject(this);
 
-	Destroy();
+	RemoveForceField();
+
+	UFPSProjectilePoolSubsystem::ReturnOrDestroy(this);
 }
\ No newline at end of file
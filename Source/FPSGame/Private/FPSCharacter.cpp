@@ -1,15 +1,41 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FPSCharacter.h"
+#include "FPSGame.h"
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Kismet/GameplayStatics.h"
-#include "DrawDebugHelpers.h"
 #include "Components/PawnNoiseEmitterComponent.h"
 #include "FPSAIGuard.h"
 #include "FPSProjectile.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSProjectileSimSubsystem.h"
+#include "FPSLagCompensationSubsystem.h"
+#include "FPSWeaponComponent.h"
 #include "Net/UnrealNetwork.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Character Tick"), STAT_FPSCharacterTick, STATGROUP_FPSGame);
+DECLARE_CYCLE_STAT(TEXT("Character ServerThrow"), STAT_FPSCharacterServerThrow, STATGROUP_FPSGame);
+
+static FAutoConsoleCommandWithWorld ThrowPredictionDumpStatsCommand(
+	TEXT("fps.ThrowPrediction.DumpStats"),
+	TEXT("Logs the throw prediction counters of the local player."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+		AFPSCharacter* Character = PC ? Cast<AFPSCharacter>(PC->GetPawn()) : nullptr;
+		if (Character)
+		{
+			const FFPSThrowPredictionStats Stats = Character->GetThrowPredictionStats();
+			const int32 Compared = Stats.Matched + Stats.Mismatched;
+			UE_LOG(LogFPSWeapons, Log, TEXT("Throw prediction: %d matched, %d mismatched, %d timed out, %d proxy finished first, average error %.1f, max error %.1f"),
+				Stats.Matched, Stats.Mismatched, Stats.TimedOut, Stats.ProxyFinishedFirst, Compared > 0 ? Stats.TotalError / Compared : 0.0f, Stats.MaxError);
+		}
+	}));
 
 AFPSCharacter::AFPSCharacter()
 {
@@ -25,6 +51,7 @@ AFPSCharacter::AFPSCharacter()
 	Mesh1PComponent->CastShadow = false;
 	Mesh1PComponent->SetRelativeRotation(FRotator(2.0f, -15.0f, 5.0f));
 	Mesh1PComponent->SetRelativeLocation(FVector(0, 0, -160.0f));
+	Mesh1PComponent->SetCollisionResponseToChannel(COLLISION_HITBOX, ECR_Ignore);
 
 	// Create a gun mesh component
 	GunMeshComponent = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("FP_Gun"));
@@ -32,13 +59,53 @@ AFPSCharacter::AFPSCharacter()
 	GunMeshComponent->SetupAttachment(Mesh1PComponent, "GripPoint");
 
 	NoiseEmitterComponent = CreateDefaultSubobject<UPawnNoiseEmitterComponent>(TEXT("NoiseEmitter"));
+
+	WeaponComponent = CreateDefaultSubobject<UFPSWeaponComponent>(TEXT("WeaponComponent"));
+
+	ThrowablePoolSize = 8;
+
+	ThrowPredictionMaxError = 150.0f;
+	ThrowPredictionBlendTime = 0.15f;
+	ThrowPredictionTimeout = 1.0f;
+	LastPredictionId = 0;
 }
 
 // Called when the game starts or when spawned
 void AFPSCharacter::BeginPlay()
 {
 	Super::BeginPlay();
+
+	WeaponComponent->SetFallbackFireEffects(FireSound, FireAnimation);
 	
+	if (HasAuthority() && ThrowableClass)
+	{
+		UFPSProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UFPSProjectilePoolSubsystem>();
+		if (Pool)
+		{
+			Pool->Prewarm(ThrowableClass, ThrowablePoolSize);
+		}
+	}
+
+	// Record where we were every server frame so shots can be checked against what the shooter saw
+	if (HasAuthority())
+	{
+		UFPSLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UFPSLagCompensationSubsystem>();
+		if (LagCompensation)
+		{
+			LagCompensation->Register(this);
+		}
+	}
+}
+
+void AFPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UFPSLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UFPSLagCompensationSubsystem>();
+	if (LagCompensation)
+	{
+		LagCompensation->Unregister(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AFPSCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -47,7 +114,8 @@ void AFPSCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCompon
 	check(PlayerInputComponent);
 
 	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
-	PlayerInputComponent->BindAction("Fire", IE_Pressed, this, &AFPSCharacter::Fire);
+	PlayerInputComponent->BindAction("Fire", IE_Pressed, WeaponComponent, &UFPSWeaponComponent::StartFire);
+	PlayerInputComponent->BindAction("Fire", IE_Released, WeaponComponent, &UFPSWeaponComponent::StopFire);
 	PlayerInputComponent->BindAction("Throw", IE_Pressed, this, &AFPSCharacter::Throw);
 
 	PlayerInputComponent->BindAxis("MoveForward", this, &AFPSCharacter::MoveForward);
@@ -59,6 +127,8 @@ void AFPSCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCompon
 
 void AFPSCharacter::Tick(float DeltaTime)
 {
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSCharacterTick);
+
 	Super::Tick(DeltaTime);
 
 	if (!IsLocallyControlled())
@@ -68,126 +138,202 @@ void AFPSCharacter::Tick(float DeltaTime)
 
 		GetFirstPersonCameraComponent()->SetRelativeRotation(NewRot);
 	}
+
+	if (PredictedThrows.Num() > 0)
+	{
+		ExpirePredictedThrows();
+	}
 }
 
-void AFPSCharacter::Fire()
+void AFPSCharacter::Throw()
 {
-	//ServerFire();
+	// Clients show the throw right away and reconcile once the server projectile replicates
+	uint8 PredictionId = 0;
+	if (!HasAuthority())
+	{
+		PredictionId = SpawnPredictedThrowable();
+	}
 
-	MakeNoise(1.0f, this);
+	ServerThrow(PredictionId);
 
-	float LineTraceDistance = 1500.0f;
+	if (ThrowSound)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, ThrowSound, GetActorLocation());
+	}
 
-	FVector CameraLocation = GetFirstPersonCameraComponent()->GetComponentLocation();
-	FRotator CameraRotation = GetFirstPersonCameraComponent()->GetComponentRotation();
-	
-	FVector TraceEnd = CameraLocation + (CameraRotation.Vector() * LineTraceDistance);
-	
-	// additional trace parameters
-	FCollisionQueryParams QueryParams;
-	QueryParams.bTraceComplex = true;
-	QueryParams.AddIgnoredActor(this);
-
-	//Re-initialize hit info
-	FHitResult Hit;
-	bool bIsHit = GetWorld()->LineTraceSingleByChannel(
-		Hit,      // FHitResult object that will be populated with hit info
-		CameraLocation,      // starting position
-		TraceEnd,        // end position
-		ECC_Visibility,  // collision channel
-		QueryParams      // additional trace settings
-	);
-
-	if (bIsHit)
-	{
-		UE_LOG(LogTemp, Warning, TEXT("We hit something"));
-		// start to end, green, will lines always stay on, depth priority, thickness of line
-		DrawDebugLine(GetWorld(), CameraLocation, TraceEnd, FColor::Green, false, 5.f, ECC_WorldStatic, 1.f);
-		
-		if (Hit.GetActor())
+	if (ThrowAnimation)
+	{
+		UAnimInstance* AnimInstance = Mesh1PComponent->GetAnimInstance();
+		if (AnimInstance)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("Hit actor name %s"), *Hit.GetActor()->GetName());
-			UE_LOG(LogTemp, Warning, TEXT("Hit actor distance %s"), *FString::SanitizeFloat(Hit.Distance));
-			DrawDebugBox(GetWorld(), Hit.ImpactPoint, FVector(10.f, 10.f, 10.f), FColor::Red, false, 5.f, ECC_WorldStatic, 5.f);
-
-			UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(Hit.GetActor()->GetRootComponent());
-			if (PrimComp && PrimComp->IsSimulatingPhysics())
-			{
-				PrimComp->AddImpulseAtLocation(CameraRotation.Vector() * 1000.f * PrimComp->GetMass(), Hit.ImpactPoint);
-			}
+			AnimInstance->PlaySlotAnimationAsDynamicMontage(ThrowAnimation, "Arms", 0.0f);
 		}
 	}
-	else
-	{
-		UE_LOG(LogTemp, Warning, TEXT("Nothing was hit"));
-		// start to end, purple, will lines always stay on, depth priority, thickness of line
-		DrawDebugLine(GetWorld(), CameraLocation, TraceEnd, FColor::Purple, false, 5.f, ECC_WorldStatic, 1.f);
-	}
+}
 
-	// try and play the sound if specified
-	if (FireSound)
+void AFPSCharacter::GetThrowSpawnLocationAndRotation(FVector& OutLocation, FRotator& OutRotation) const
+{
+	//To Spawn outside player collision box
+	float ProjectileSpawnOffset = 30.0f;
+
+	FVector PlayerLocation = GetActorLocation();
+	OutRotation = GetFirstPersonCameraComponent()->GetComponentRotation();
+
+	OutLocation = PlayerLocation + (OutRotation.Vector() * ProjectileSpawnOffset);
+}
+
+uint8 AFPSCharacter::SpawnPredictedThrowable()
+{
+	UFPSProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UFPSProjectilePoolSubsystem>();
+	if (ThrowableClass == nullptr || Pool == nullptr)
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation());
+		return 0;
 	}
 
-	// try and play a firing animation if specified
-	if (FireAnimation)
+	FVector SpawnLocation;
+	FRotator SpawnRotation;
+	GetThrowSpawnLocationAndRotation(SpawnLocation, SpawnRotation);
+
+	// Spawned on the client, so the proxy is a local actor that never replicates
+	AFPSProjectile* Proxy = Cast<AFPSProjectile>(Pool->Acquire(ThrowableClass, FTransform(SpawnRotation, SpawnLocation), this));
+	if (Proxy == nullptr)
 	{
-		// Get the animation object for the arms mesh
-		UAnimInstance* AnimInstance = GetMesh1P()->GetAnimInstance();
-		if (AnimInstance)
-		{
-			AnimInstance->PlaySlotAnimationAsDynamicMontage(FireAnimation, "Arms", 0.0f);
-		}
+		return 0;
 	}
+
+	// 0 is reserved for throws that weren't predicted
+	LastPredictionId = (LastPredictionId == MAX_uint8) ? 1 : LastPredictionId + 1;
+
+	Proxy->SetPredictionId(LastPredictionId);
+	PredictedThrows.Add({ LastPredictionId, Proxy, GetWorld()->GetTimeSeconds() });
+
+	return LastPredictionId;
 }
 
-void AFPSCharacter::Throw()
+void AFPSCharacter::ReconcilePredictedThrowable(AFPSProjectile* Authoritative)
 {
-	ServerThrow();
+	const uint8 PredictionId = Authoritative->GetPredictionId();
+	const int32 Index = PredictedThrows.IndexOfByPredicate([PredictionId](const FPredictedThrow& Predicted) { return Predicted.PredictionId == PredictionId; });
+	if (Index == INDEX_NONE)
+	{
+		// Already timed out
+		return;
+	}
 
-	if (ThrowSound)
+	AFPSProjectile* Proxy = PredictedThrows[Index].Proxy.Get();
+	const float ProxyFlightTime = GetWorld()->GetTimeSeconds() - PredictedThrows[Index].SpawnTime;
+	PredictedThrows.RemoveAtSwap(Index);
+
+	// The proxy is recycled by the pool once it hits something, it may even be flying for another throw by now
+	if (Proxy == nullptr || Proxy->GetPredictionId() != PredictionId)
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, ThrowSound, GetActorLocation());
+		ThrowPredictionStats.ProxyFinishedFirst++;
+		return;
 	}
 
-	if (ThrowAnimation)
+	// Our proxy has been flying since the throw, the server's projectile only for as long as its replicated location accounts for.
+	// That's close to the full round trip, bring it level with the real elapsed times before comparing
+	const float Lead = FMath::Max(ProxyFlightTime - Authoritative->GetReplicatedFlightTime(), 0.0f);
+	const FVector ExpectedLocation = Authoritative->GetActorLocation() + Authoritative->GetVelocity() * Lead;
+
+	const float Error = FVector::Dist(Proxy->GetActorLocation(), ExpectedLocation);
+	ThrowPredictionStats.TotalError += Error;
+	ThrowPredictionStats.MaxError = FMath::Max(ThrowPredictionStats.MaxError, Error);
+
+	if (Error <= ThrowPredictionMaxError)
 	{
-		UAnimInstance* AnimInstance = Mesh1PComponent->GetAnimInstance();
-		if (AnimInstance)
+		ThrowPredictionStats.Matched++;
+
+		Authoritative->BlendFromPredictedLocation(Proxy->GetActorLocation(), ThrowPredictionBlendTime);
+	}
+	else
+	{
+		ThrowPredictionStats.Mismatched++;
+	}
+
+	UFPSProjectilePoolSubsystem::ReturnOrDestroy(Proxy);
+}
+
+void AFPSCharacter::ExpirePredictedThrows()
+{
+	const float ExpireTime = GetWorld()->GetTimeSeconds() - ThrowPredictionTimeout;
+
+	for (int32 i = PredictedThrows.Num() - 1; i >= 0; i--)
+	{
+		if (PredictedThrows[i].SpawnTime > ExpireTime)
 		{
-			AnimInstance->PlaySlotAnimationAsDynamicMontage(ThrowAnimation, "Arms", 0.0f);
+			continue;
 		}
+
+		ThrowPredictionStats.TimedOut++;
+
+		AFPSProjectile* Proxy = PredictedThrows[i].Proxy.Get();
+		if (Proxy && Proxy->GetPredictionId() == PredictedThrows[i].PredictionId)
+		{
+			UFPSProjectilePoolSubsystem::ReturnOrDestroy(Proxy);
+		}
+
+		PredictedThrows.RemoveAtSwap(i);
 	}
 }
 
-void AFPSCharacter::ServerThrow_Implementation()
+void AFPSCharacter::ServerThrow_Implementation(uint8 PredictionId)
 {
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSCharacterServerThrow);
+
 	if (ThrowableClass)
 	{
-		//To Spawn outside player collision box
-		float ProjectileSpawnOffset = 30.0f;
-
-		FVector PlayerLocation = GetActorLocation();
-		FRotator PlayerRotation = GetFirstPersonCameraComponent()->GetComponentRotation();
+		FVector SpawnLocation;
+		FRotator PlayerRotation;
+		GetThrowSpawnLocationAndRotation(SpawnLocation, PlayerRotation);
 
-		FVector SpawnLocation = PlayerLocation + (PlayerRotation.Vector() * ProjectileSpawnOffset);
-
-		//Set Spawn Collision Handling Override
-		FActorSpawnParameters ActorSpawnParams;
-		ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-		ActorSpawnParams.Instigator = this;
+		// fly the projectile in the batched simulation when enabled, it only becomes an actor once it hits something
+		UFPSProjectileSimSubsystem* ProjectileSim = GetWorld()->GetSubsystem<UFPSProjectileSimSubsystem>();
+		if (ProjectileSim && ProjectileSim->Launch(ThrowableClass, SpawnLocation, PlayerRotation, this, PredictionId))
+		{
+			if (GetNetMode() != NM_Standalone)
+			{
+				MulticastSimulatedThrow(ThrowableClass, SpawnLocation, PlayerRotation, GetWorld()->GetTimeSeconds(), PredictionId);
+			}
+			return;
+		}
 
-		// spawn the projectile at Character Location
-		GetWorld()->SpawnActor<AFPSProjectile>(ThrowableClass, SpawnLocation, PlayerRotation, ActorSpawnParams);
+		// take the projectile from the pool, spawning one at Character Location if none is parked
+		UFPSProjectilePoolSubsystem* Pool = GetWorld()->GetSubsystem<UFPSProjectilePoolSubsystem>();
+		if (Pool)
+		{
+			AFPSProjectile* Projectile = Cast<AFPSProjectile>(Pool->Acquire(ThrowableClass, FTransform(PlayerRotation, SpawnLocation), this));
+			if (Projectile)
+			{
+				Projectile->SetPredictionId(PredictionId);
+			}
+		}
 	}
 }
 
-bool AFPSCharacter::ServerThrow_Validate()
+bool AFPSCharacter::ServerThrow_Validate(uint8 PredictionId)
 {
 	return true;
 }
 
+void AFPSCharacter::MulticastSimulatedThrow_Implementation(TSubclassOf<AActor> Class, FVector_NetQuantize Location, FRotator Rotation, float ServerLaunchTime, uint8 PredictionId)
+{
+	// The server renders the real one, and a thrower that predicted already has its proxy in the air
+	if (GetNetMode() != NM_Client || (PredictionId != 0 && IsLocallyControlled()))
+	{
+		return;
+	}
+
+	UFPSProjectileSimSubsystem* ProjectileSim = GetWorld()->GetSubsystem<UFPSProjectileSimSubsystem>();
+	if (ProjectileSim)
+	{
+		const AGameStateBase* GameState = GetWorld()->GetGameState();
+		const float ElapsedTime = GameState ? GameState->GetServerWorldTimeSeconds() - ServerLaunchTime : 0.0f;
+
+		ProjectileSim->LaunchCosmetic(Class, Location, Rotation, this, ElapsedTime);
+	}
+}
+
 void AFPSCharacter::MoveForward(float Value)
 {
 	if (Value != 0.0f)
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSDebugDrawSubsystem.h"
+#include "FPSGame.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Debug Draw Tick"), STAT_FPSDebugDrawTick, STATGROUP_FPSGame);
+
+#if FPS_DEBUG_DRAW
+static TAutoConsoleVariable<int32> CVarDebugDrawWeapons(
+	TEXT("fps.DebugDraw.Weapons"),
+	0,
+	TEXT("When 1 hitscan traces and their hits are drawn. Not replicated, clients of a dedicated server only see what their own game draws."),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarDebugDrawAI(
+	TEXT("fps.DebugDraw.AI"),
+	0,
+	TEXT("When 1 what the guards see and hear is drawn. Not replicated, clients of a dedicated server only see what their own game draws."),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarDebugDrawExplosions(
+	TEXT("fps.DebugDraw.Explosions"),
+	0,
+	TEXT("When 1 the radius of grenade and black hole explosions is drawn. Not replicated, clients of a dedicated server only see what their own game draws."),
+	ECVF_Cheat);
+
+static TAutoConsoleVariable<int32> CVarDebugDrawMaxPrimitives(
+	TEXT("fps.DebugDraw.MaxPrimitives"),
+	1024,
+	TEXT("Size of the debug primitive ring buffer, the oldest primitives are dropped past it. Read on the first primitive of a world."),
+	ECVF_Default);
+#endif
+
+bool UFPSDebugDrawSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+#if FPS_DEBUG_DRAW
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+#else
+	return false;
+#endif
+}
+
+void UFPSDebugDrawSubsystem::Deinitialize()
+{
+	Primitives.Empty();
+	Head = 0;
+	Num = 0;
+
+	Super::Deinitialize();
+}
+
+UFPSDebugDrawSubsystem* UFPSDebugDrawSubsystem::Get(const UWorld* World, EFPSDebugCategory Category)
+{
+#if FPS_DEBUG_DRAW
+	if (World == nullptr || World->GetNetMode() == NM_DedicatedServer)
+	{
+		return nullptr;
+	}
+
+	bool bEnabled = false;
+	switch (Category)
+	{
+	case EFPSDebugCategory::Weapons:
+		bEnabled = CVarDebugDrawWeapons.GetValueOnGameThread() != 0;
+		break;
+	case EFPSDebugCategory::AI:
+		bEnabled = CVarDebugDrawAI.GetValueOnGameThread() != 0;
+		break;
+	case EFPSDebugCategory::Explosions:
+		bEnabled = CVarDebugDrawExplosions.GetValueOnGameThread() != 0;
+		break;
+	}
+
+	return bEnabled ? World->GetSubsystem<UFPSDebugDrawSubsystem>() : nullptr;
+#else
+	return nullptr;
+#endif
+}
+
+void UFPSDebugDrawSubsystem::AddLine(const FVector& Start, const FVector& End, const FColor& Color, float Duration, float Thickness)
+{
+	FFPSDebugPrimitive& Primitive = AddPrimitive(EFPSDebugShape::Line, Color, Duration, Thickness);
+	Primitive.Location = Start;
+	Primitive.Vector = End;
+}
+
+void UFPSDebugDrawSubsystem::AddBox(const FVector& Center, const FVector& Extent, const FColor& Color, float Duration, float Thickness)
+{
+	FFPSDebugPrimitive& Primitive = AddPrimitive(EFPSDebugShape::Box, Color, Duration, Thickness);
+	Primitive.Location = Center;
+	Primitive.Vector = Extent;
+}
+
+void UFPSDebugDrawSubsystem::AddSphere(const FVector& Center, float Radius, int32 Segments, const FColor& Color, float Duration, float Thickness)
+{
+	FFPSDebugPrimitive& Primitive = AddPrimitive(EFPSDebugShape::Sphere, Color, Duration, Thickness);
+	Primitive.Location = Center;
+	Primitive.Radius = Radius;
+	Primitive.Segments = Segments;
+}
+
+FFPSDebugPrimitive& UFPSDebugDrawSubsystem::AddPrimitive(EFPSDebugShape Shape, const FColor& Color, float Duration, float Thickness)
+{
+	// Only allocated once something is drawn
+	if (Primitives.Num() == 0)
+	{
+#if FPS_DEBUG_DRAW
+		Primitives.SetNum(FMath::Max(1, CVarDebugDrawMaxPrimitives.GetValueOnGameThread()));
+#else
+		Primitives.SetNum(1);
+#endif
+	}
+
+	FFPSDebugPrimitive& Primitive = Primitives[Head];
+	Primitive.Shape = Shape;
+	Primitive.Color = Color;
+	Primitive.Thickness = Thickness;
+	Primitive.ExpireTime = GetWorld()->GetTimeSeconds() + Duration;
+
+	Head = (Head + 1) % Primitives.Num();
+	Num = FMath::Min(Num + 1, Primitives.Num());
+
+	return Primitive;
+}
+
+void UFPSDebugDrawSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSDebugDrawTick);
+
+	UWorld* World = GetWorld();
+	const float Now = World->GetTimeSeconds();
+	const int32 Capacity = Primitives.Num();
+
+	// Forget the oldest ones once they run out, the ones behind them may have longer durations and are skipped below
+	while (Num > 0 && Primitives[(Head - Num + Capacity) % Capacity].ExpireTime < Now)
+	{
+		Num--;
+	}
+
+	for (int32 i = Num; i > 0; i--)
+	{
+		const FFPSDebugPrimitive& Primitive = Primitives[(Head - i + Capacity) % Capacity];
+		if (Primitive.ExpireTime < Now)
+		{
+			continue;
+		}
+
+		// Drawn for this frame only, the buffer redraws it next frame
+		switch (Primitive.Shape)
+		{
+		case EFPSDebugShape::Line:
+			DrawDebugLine(World, Primitive.Location, Primitive.Vector, Primitive.Color, false, -1.0f, 0, Primitive.Thickness);
+			break;
+		case EFPSDebugShape::Box:
+			DrawDebugBox(World, Primitive.Location, Primitive.Vector, Primitive.Color, false, -1.0f, 0, Primitive.Thickness);
+			break;
+		case EFPSDebugShape::Sphere:
+			DrawDebugSphere(World, Primitive.Location, Primitive.Radius, Primitive.Segments, Primitive.Color, false, -1.0f, 0, Primitive.Thickness);
+			break;
+		}
+	}
+}
+
+ETickableTickType UFPSDebugDrawSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSDebugDrawSubsystem::IsTickable() const
+{
+	return Num > 0;
+}
+
+TStatId UFPSDebugDrawSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSDebugDrawSubsystem, STATGROUP_Tickables);
+}
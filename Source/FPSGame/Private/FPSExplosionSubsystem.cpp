@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSExplosionSubsystem.h"
+#include "FPSGame.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Explosion Tick"), STAT_FPSExplosionTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion Targets"), STAT_FPSExplosionTargets, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<int32> CVarExplosionOcclusion(
+	TEXT("fps.Explosion.Occlusion"),
+	1,
+	TEXT("When 1 explosion impulses are scaled by line of sight from the blast, when 0 walls don't shield anything."),
+	ECVF_Default);
+
+void UFPSExplosionSubsystem::Deinitialize()
+{
+	Explosions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSExplosionSubsystem::Explode(AActor* Source, const FVector& Center, float Radius, float Strength, ERadialImpulseFalloff Falloff)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	FFPSExplosion& Explosion = Explosions.AddDefaulted_GetRef();
+	Explosion.Source = Source;
+	Explosion.Center = Center;
+	Explosion.Radius = Radius;
+	Explosion.Strength = Strength;
+	Explosion.Falloff = Falloff;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSExplosion), false, Source);
+
+	Explosion.OverlapHandle = World->AsyncOverlapByObjectType(Center,
+		FQuat::Identity,
+		FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllObjects),
+		FCollisionShape::MakeSphere(Radius),
+		QueryParams);
+}
+
+void UFPSExplosionSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSExplosionTick);
+
+	// Impulses first so the traces issued below for newer explosions are only read next frame
+	for (int32 i = Explosions.Num() - 1; i >= 0; i--)
+	{
+		if (Explosions[i].bTracesIssued && TryApplyImpulses(Explosions[i]))
+		{
+			Explosions.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	for (FFPSExplosion& Explosion : Explosions)
+	{
+		if (!Explosion.bTracesIssued)
+		{
+			Explosion.bTracesIssued = TryIssueTraces(Explosion);
+		}
+	}
+
+	int32 NumTargets = 0;
+	for (const FFPSExplosion& Explosion : Explosions)
+	{
+		NumTargets += Explosion.Targets.Num();
+	}
+	FPS_SET_COUNTER(STAT_FPSExplosionTargets, NumTargets);
+}
+
+bool UFPSExplosionSubsystem::TryIssueTraces(FFPSExplosion& Explosion)
+{
+	UWorld* World = GetWorld();
+
+	FOverlapDatum Datum;
+	if (!World->QueryOverlapData(Explosion.OverlapHandle, Datum))
+	{
+		// Still running, unless the result was dropped, in which case nothing gets pushed
+		return !World->IsTraceHandleValid(Explosion.OverlapHandle, true);
+	}
+
+	const bool bOcclusion = CVarExplosionOcclusion.GetValueOnGameThread() != 0;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSExplosionOcclusion), false, Explosion.Source.Get());
+
+	for (const FOverlapResult& Overlap : Datum.OutOverlaps)
+	{
+		AActor* OverlapActor = Overlap.GetActor();
+		if (OverlapActor == nullptr || Explosion.Targets.ContainsByPredicate([OverlapActor](const FFPSExplosionTarget& Target) { return Target.Actor == OverlapActor; }))
+		{
+			continue;
+		}
+
+		FFPSExplosionTarget Target;
+		Target.Actor = OverlapActor;
+
+		ACharacter* Character = Cast<ACharacter>(OverlapActor);
+		UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(OverlapActor->GetRootComponent());
+		if (Character && Character->GetCharacterMovement())
+		{
+			Target.CharacterMovement = Character->GetCharacterMovement();
+		}
+		else if (PrimComp && PrimComp->IsSimulatingPhysics())
+		{
+			// the component we are looking for! It needs to be simulating in order to apply forces.
+			Target.Component = PrimComp;
+		}
+		else
+		{
+			continue;
+		}
+
+		if (bOcclusion && PrimComp)
+		{
+			// Center, upper and lower part of the body
+			const FBoxSphereBounds& Bounds = PrimComp->Bounds;
+			const FVector SampleOffset(0.0f, 0.0f, Bounds.BoxExtent.Z * 0.75f);
+			const FVector Samples[FFPSExplosionTarget::NumExposureSamples] = { Bounds.Origin, Bounds.Origin + SampleOffset, Bounds.Origin - SampleOffset };
+
+			for (int32 i = 0; i < FFPSExplosionTarget::NumExposureSamples; i++)
+			{
+				Target.Traces[i] = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Explosion.Center, Samples[i], ECC_Visibility, QueryParams);
+			}
+		}
+
+		Explosion.Targets.Add(Target);
+	}
+
+	return true;
+}
+
+bool UFPSExplosionSubsystem::TryApplyImpulses(FFPSExplosion& Explosion)
+{
+	Exposures.Reset();
+
+	for (const FFPSExplosionTarget& Target : Explosion.Targets)
+	{
+		float Exposure = 1.0f;
+		if (!TryGetExposure(Target, Exposure))
+		{
+			return false;
+		}
+
+		Exposures.Add(Exposure);
+	}
+
+	for (int32 i = 0; i < Explosion.Targets.Num(); i++)
+	{
+		const FFPSExplosionTarget& Target = Explosion.Targets[i];
+		if (Exposures[i] <= 0.0f)
+		{
+			continue;
+		}
+
+		const float Strength = Explosion.Strength * Exposures[i];
+
+		UCharacterMovementComponent* CharacterComp = Target.CharacterMovement.Get();
+		if (CharacterComp)
+		{
+			CharacterComp->AddRadialImpulse(Explosion.Center, Explosion.Radius, Strength, Explosion.Falloff, true);
+			continue;
+		}
+
+		UPrimitiveComponent* PrimComp = Target.Component.Get();
+		if (PrimComp)
+		{
+			PrimComp->AddRadialImpulse(Explosion.Center, Explosion.Radius, Strength, Explosion.Falloff, true);
+		}
+	}
+
+	return true;
+}
+
+bool UFPSExplosionSubsystem::TryGetExposure(const FFPSExplosionTarget& Target, float& OutExposure) const
+{
+	UWorld* World = GetWorld();
+
+	int32 NumTraced = 0;
+	int32 NumClear = 0;
+	for (const FTraceHandle& Handle : Target.Traces)
+	{
+		if (!Handle.IsValid())
+		{
+			continue;
+		}
+
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(Handle, Datum))
+		{
+			// Still running, unless the result was dropped
+			if (World->IsTraceHandleValid(Handle, false))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		NumTraced++;
+
+		// Clear when nothing blocks the line, or the first thing it hits is the body itself
+		const FHitResult* Hit = Datum.OutHits.FindByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; });
+		if (Hit == nullptr || Hit->GetActor() == Target.Actor.Get())
+		{
+			NumClear++;
+		}
+	}
+
+	// Not traced (occlusion off) or the results were lost, push as if nothing was in the way
+	OutExposure = NumTraced > 0 ? (float)NumClear / NumTraced : 1.0f;
+	return true;
+}
+
+ETickableTickType UFPSExplosionSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSExplosionSubsystem::IsTickable() const
+{
+	return Explosions.Num() > 0;
+}
+
+TStatId UFPSExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSExplosionSubsystem, STATGROUP_Tickables);
+}
@@ -2,6 +2,7 @@
 
 
 #include "FPSExtractionZone.h"
+#include "FPSGame.h"
 #include "Components/BoxComponent.h"
 #include "Components/DecalComponent.h"
 #include "FPSCharacter.h"
@@ -46,6 +47,6 @@ void AFPSExtractionZone::HandleOverlap(UPrimitiveComponent* OverlappedComponent,
 		UGameplayStatics::PlaySound2D(this, ObjectiveMissingSound);
 	}
 
-	UE_LOG(LogTemp, Log, TEXT("Overlapped with extraction zone!!"));
+	UE_LOG(LogFPSObjective, Verbose, TEXT("Overlapped with extraction zone!!"));
 }
 
@@ -0,0 +1,376 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSForceFieldSubsystem.h"
+#include "FPSGame.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/Character.h"
+#include "FPSAIGuard.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Force Field Tick"), STAT_FPSForceFieldTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Black Holes"), STAT_FPSBlackHoles, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Force Field Targets"), STAT_FPSForceFieldTargets, STATGROUP_FPSGame);
+
+// Bodies missing from the overlaps for this many ticks are dropped, covers a field's result arriving a frame late
+static const uint32 ForceFieldBodyGraceTicks = 2;
+
+int32 FFPSForceFieldBodies::Add(AActor* Actor, UPrimitiveComponent* Component, UCharacterMovementComponent* CharacterMovement, uint32 SeenTick)
+{
+	X.Add(0.0f);
+	Y.Add(0.0f);
+	Z.Add(0.0f);
+	AccelX.Add(0.0f);
+	AccelY.Add(0.0f);
+	AccelZ.Add(0.0f);
+	Actors.Add(Actor);
+	Components.Add(Component);
+	CharacterMovements.Add(CharacterMovement);
+	return LastSeenTicks.Add(SeenTick);
+}
+
+void FFPSForceFieldBodies::RemoveAtSwap(int32 Index)
+{
+	X.RemoveAtSwap(Index, 1, false);
+	Y.RemoveAtSwap(Index, 1, false);
+	Z.RemoveAtSwap(Index, 1, false);
+	AccelX.RemoveAtSwap(Index, 1, false);
+	AccelY.RemoveAtSwap(Index, 1, false);
+	AccelZ.RemoveAtSwap(Index, 1, false);
+	Actors.RemoveAtSwap(Index, 1, false);
+	Components.RemoveAtSwap(Index, 1, false);
+	CharacterMovements.RemoveAtSwap(Index, 1, false);
+	LastSeenTicks.RemoveAtSwap(Index, 1, false);
+}
+
+void FFPSForceFieldBodies::Reset()
+{
+	X.Reset();
+	Y.Reset();
+	Z.Reset();
+	AccelX.Reset();
+	AccelY.Reset();
+	AccelZ.Reset();
+	Actors.Reset();
+	Components.Reset();
+	CharacterMovements.Reset();
+	LastSeenTicks.Reset();
+}
+
+void UFPSForceFieldSubsystem::Deinitialize()
+{
+	Fields.Empty();
+	Bodies.Reset();
+	BodyIndices.Empty();
+	IgnoredActors.Empty();
+
+	Super::Deinitialize();
+}
+
+int32 UFPSForceFieldSubsystem::AddField(AActor* Owner, const FVector& Center, float Radius, float Strength, ERadialImpulseFalloff Falloff)
+{
+	FFPSForceField& Field = Fields.AddDefaulted_GetRef();
+	Field.Id = NextFieldId++;
+	Field.Owner = Owner;
+	Field.Center = Center;
+	Field.QueryCenter = Center;
+	Field.Radius = Radius;
+	Field.Strength = Strength;
+	Field.Falloff = Falloff;
+
+	return Field.Id;
+}
+
+void UFPSForceFieldSubsystem::MoveField(int32 FieldId, const FVector& Center)
+{
+	FFPSForceField* Field = FindField(FieldId);
+	if (Field)
+	{
+		Field->QueryCenter += Center - Field->Center;
+		Field->Center = Center;
+	}
+}
+
+void UFPSForceFieldSubsystem::SetFieldQueryCenter(int32 FieldId, const FVector& QueryCenter)
+{
+	FFPSForceField* Field = FindField(FieldId);
+	if (Field)
+	{
+		Field->QueryCenter = QueryCenter;
+	}
+}
+
+void UFPSForceFieldSubsystem::RemoveField(int32 FieldId)
+{
+	const int32 Index = Fields.IndexOfByPredicate([FieldId](const FFPSForceField& Field) { return Field.Id == FieldId; });
+	if (Index != INDEX_NONE)
+	{
+		Fields.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+void UFPSForceFieldSubsystem::SetFieldPaused(int32 FieldId, bool bPaused)
+{
+	FFPSForceField* Field = FindField(FieldId);
+	if (Field)
+	{
+		Field->bPaused = bPaused;
+	}
+}
+
+FFPSForceField* UFPSForceFieldSubsystem::FindField(int32 FieldId)
+{
+	return Fields.FindByPredicate([FieldId](const FFPSForceField& Field) { return Field.Id == FieldId; });
+}
+
+void UFPSForceFieldSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSForceFieldTick);
+
+	TickCount++;
+
+	// Fields whose owner went away without removing them
+	for (int32 i = Fields.Num() - 1; i >= 0; i--)
+	{
+		if (!Fields[i].Owner.IsValid())
+		{
+			Fields.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	GatherBodies();
+	UpdateBodies();
+
+	FPS_SET_COUNTER(STAT_FPSBlackHoles, Fields.Num());
+	FPS_SET_COUNTER(STAT_FPSForceFieldTargets, Bodies.Num());
+
+	if (Bodies.Num() > 0)
+	{
+		AccumulateForces();
+		ApplyForces();
+	}
+
+	IssueOverlaps();
+}
+
+void UFPSForceFieldSubsystem::GatherBodies()
+{
+	UWorld* World = GetWorld();
+
+	for (FFPSForceField& Field : Fields)
+	{
+		FOverlapDatum Datum;
+		if (!Field.OverlapHandle.IsValid() || !World->QueryOverlapData(Field.OverlapHandle, Datum))
+		{
+			continue;
+		}
+
+		Field.OverlapHandle = FTraceHandle();
+
+		for (const FOverlapResult& Overlap : Datum.OutOverlaps)
+		{
+			// Bodies in several fields are only added once, their forces are summed below
+			const int32* BodyIndex = BodyIndices.Find(Overlap.Actor);
+			if (BodyIndex)
+			{
+				Bodies.LastSeenTicks[*BodyIndex] = TickCount;
+				continue;
+			}
+
+			uint32* IgnoredSeenTick = IgnoredActors.Find(Overlap.Actor);
+			if (IgnoredSeenTick)
+			{
+				*IgnoredSeenTick = TickCount;
+				continue;
+			}
+
+			AActor* OverlapActor = Overlap.GetActor();
+			if (OverlapActor && !AddBody(OverlapActor))
+			{
+				IgnoredActors.Add(OverlapActor, TickCount);
+			}
+		}
+	}
+}
+
+bool UFPSForceFieldSubsystem::AddBody(AActor* Actor)
+{
+	ACharacter* Character = Cast<ACharacter>(Actor);
+	UCharacterMovementComponent* CharacterComp = Character ? Character->GetCharacterMovement() : nullptr;
+	if (CharacterComp)
+	{
+		BodyIndices.Add(Actor, Bodies.Add(Actor, nullptr, CharacterComp, TickCount));
+		return true;
+	}
+
+	// the component we are looking for! It needs to be simulating in order to apply forces.
+	UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+	if (PrimComp && PrimComp->IsSimulatingPhysics())
+	{
+		BodyIndices.Add(Actor, Bodies.Add(Actor, PrimComp, nullptr, TickCount));
+		return true;
+	}
+
+	return false;
+}
+
+void UFPSForceFieldSubsystem::UpdateBodies()
+{
+	for (int32 i = Bodies.Num() - 1; i >= 0; i--)
+	{
+		const USceneComponent* Target = Bodies.CharacterMovements[i].IsValid() ? Bodies.CharacterMovements[i]->UpdatedComponent : Bodies.Components[i].Get();
+		const bool bGone = (Target == nullptr) || !Bodies.Actors[i].IsValid();
+
+		if (bGone || TickCount - Bodies.LastSeenTicks[i] > ForceFieldBodyGraceTicks)
+		{
+			BodyIndices.Remove(Bodies.Actors[i]);
+			Bodies.RemoveAtSwap(i);
+
+			// The last body moved into this slot
+			if (i < Bodies.Num())
+			{
+				BodyIndices.Add(Bodies.Actors[i], i);
+			}
+			continue;
+		}
+
+		const FVector Position = Target->GetComponentLocation();
+		Bodies.X[i] = Position.X;
+		Bodies.Y[i] = Position.Y;
+		Bodies.Z[i] = Position.Z;
+	}
+
+	for (auto It = IgnoredActors.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || TickCount - It.Value() > ForceFieldBodyGraceTicks)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	if (Bodies.Num() > 0)
+	{
+		FMemory::Memzero(Bodies.AccelX.GetData(), Bodies.Num() * sizeof(float));
+		FMemory::Memzero(Bodies.AccelY.GetData(), Bodies.Num() * sizeof(float));
+		FMemory::Memzero(Bodies.AccelZ.GetData(), Bodies.Num() * sizeof(float));
+	}
+}
+
+void UFPSForceFieldSubsystem::AccumulateForces()
+{
+	const int32 NumBodies = Bodies.Num();
+
+	const float* RESTRICT BodyX = Bodies.X.GetData();
+	const float* RESTRICT BodyY = Bodies.Y.GetData();
+	const float* RESTRICT BodyZ = Bodies.Z.GetData();
+	float* RESTRICT AccelX = Bodies.AccelX.GetData();
+	float* RESTRICT AccelY = Bodies.AccelY.GetData();
+	float* RESTRICT AccelZ = Bodies.AccelZ.GetData();
+
+	// Same force as UPrimitiveComponent::AddRadialForce, written branch-free over flat arrays so the inner loop vectorizes
+	for (const FFPSForceField& Field : Fields)
+	{
+		if (Field.bPaused)
+		{
+			continue;
+		}
+
+		const float CenterX = Field.Center.X;
+		const float CenterY = Field.Center.Y;
+		const float CenterZ = Field.Center.Z;
+		const float RadiusSq = FMath::Square(Field.Radius);
+		const float InvRadius = Field.Radius > 0.0f ? 1.0f / Field.Radius : 0.0f;
+		const float LinearFalloff = (Field.Falloff == RIF_Linear) ? 1.0f : 0.0f;
+		const float Strength = Field.Strength;
+
+		for (int32 i = 0; i < NumBodies; i++)
+		{
+			const float DeltaX = BodyX[i] - CenterX;
+			const float DeltaY = BodyY[i] - CenterY;
+			const float DeltaZ = BodyZ[i] - CenterZ;
+
+			const float DistSq = DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+			const float InvDist = FMath::InvSqrt(FMath::Max(DistSq, KINDA_SMALL_NUMBER));
+			const float Dist = DistSq * InvDist;
+
+			const float Falloff = 1.0f - LinearFalloff * Dist * InvRadius;
+			const float InRange = (DistSq < RadiusSq) ? 1.0f : 0.0f;
+			const float Scale = InRange * Strength * Falloff * InvDist;
+
+			AccelX[i] += DeltaX * Scale;
+			AccelY[i] += DeltaY * Scale;
+			AccelZ[i] += DeltaZ * Scale;
+		}
+	}
+}
+
+void UFPSForceFieldSubsystem::ApplyForces()
+{
+	for (int32 i = 0; i < Bodies.Num(); i++)
+	{
+		const FVector Accel(Bodies.AccelX[i], Bodies.AccelY[i], Bodies.AccelZ[i]);
+		if (Accel.IsNearlyZero())
+		{
+			continue;
+		}
+
+		UCharacterMovementComponent* CharacterComp = Bodies.CharacterMovements[i].Get();
+		if (CharacterComp)
+		{
+			CharacterComp->AddForce(Accel * CharacterComp->Mass);
+
+			AFPSAIGuard* Guard = Cast<AFPSAIGuard>(CharacterComp->GetOwner());
+			if (Guard)
+			{
+				Guard->WakeForMovement();
+			}
+		}
+		else
+		{
+			Bodies.Components[i]->AddForce(Accel, NAME_None, true);
+		}
+	}
+}
+
+void UFPSForceFieldSubsystem::IssueOverlaps()
+{
+	UWorld* World = GetWorld();
+
+	for (FFPSForceField& Field : Fields)
+	{
+		if (Field.bPaused)
+		{
+			continue;
+		}
+
+		// Still waiting on last frame's result
+		if (Field.OverlapHandle.IsValid() && World->IsTraceHandleValid(Field.OverlapHandle, true))
+		{
+			continue;
+		}
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSForceField), false, Field.Owner.Get());
+
+		Field.OverlapHandle = World->AsyncOverlapByObjectType(Field.QueryCenter,
+			FQuat::Identity,
+			FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllObjects),
+			FCollisionShape::MakeSphere(Field.Radius),
+			QueryParams);
+	}
+}
+
+ETickableTickType UFPSForceFieldSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSForceFieldSubsystem::IsTickable() const
+{
+	return Fields.Num() > 0;
+}
+
+TStatId UFPSForceFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSForceFieldSubsystem, STATGROUP_Tickables);
+}
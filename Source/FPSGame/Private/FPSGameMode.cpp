@@ -1,6 +1,7 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FPSGameMode.h"
+#include "FPSGame.h"
 #include "FPSHUD.h"
 #include "FPSCharacter.h"
 #include "UObject/ConstructorHelpers.h"
@@ -8,6 +9,8 @@
 #include "FPSGameState.h"
 #include "EngineUtils.h"
 
+DECLARE_CYCLE_STAT(TEXT("CompleteMission"), STAT_FPSCompleteMission, STATGROUP_FPSGame);
+
 
 AFPSGameMode::AFPSGameMode()
 {
@@ -23,6 +26,8 @@ AFPSGameMode::AFPSGameMode()
 
 void AFPSGameMode::CompleteMission(APawn* InstigatorPawn, bool bMissionSuccess)
 {
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSCompleteMission);
+
 	if (InstigatorPawn)
 	{
 		if (SpectatingViewpointClass)
@@ -43,7 +48,7 @@ void AFPSGameMode::CompleteMission(APawn* InstigatorPawn, bool bMissionSuccess)
 		}
 		else
 		{
-			UE_LOG(LogTemp, Warning, TEXT("SpectatingViewpointClass is nullptr. Please update GameMode class with valid subclass. Cannot change spectating view target."));
+			UE_LOG(LogFPSGame, Warning, TEXT("SpectatingViewpointClass is nullptr. Please update GameMode class with valid subclass. Cannot change spectating view target."));
 		}
 	}
 
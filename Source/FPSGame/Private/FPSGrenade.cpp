@@ -2,14 +2,18 @@
 
 
 #include "FPSGrenade.h"
+#include "FPSGame.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
 #include "Components/StaticMeshComponent.h"
-#include "DrawDebugHelpers.h"
+#include "FPSDebugDrawSubsystem.h"
 #include "Kismet/GameplayStatics.h"
-#include "GameFramework/CharacterMovementComponent.h"
-#include "GameFramework/Character.h"
 #include "TimerManager.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSExplosionSubsystem.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Grenade OnExplode"), STAT_FPSGrenadeExplode, STATGROUP_FPSGame);
 
 // Sets default values
 AFPSGrenade::AFPSGrenade()
@@ -32,11 +36,6 @@ AFPSGrenade::AFPSGrenade()
 	// Set as root component
 	RootComponent = CollisionComp;
 
-	OuterSphereComponent = CreateDefaultSubobject<USphereComponent>(TEXT("OuterSphereComp"));
-	OuterSphereComponent->InitSphereRadius(GrenadeRadius);
-	OuterSphereComponent->SetCollisionProfileName("OverlapAll");
-	OuterSphereComponent->SetupAttachment(RootComponent);
-
 	// Use a ProjectileMovementComponent to govern this projectile's movement
 	GrenadeMovement = CreateDefaultSubobject<UProjectileMovementComponent>(TEXT("ProjectileComp"));
 	GrenadeMovement->UpdatedComponent = CollisionComp;
@@ -54,10 +53,37 @@ void AFPSGrenade::BeginPlay()
 {
 	Super::BeginPlay();
 
+	StartFuze();
+}
+
+void AFPSGrenade::StartFuze()
+{
 	/* Activate the fuze to explode the bomb after several seconds */
 	GetWorldTimerManager().SetTimer(FuzeTimerHandle, this, &AFPSGrenade::OnExplode, MaxFuzeTime, false);
 }
 
+void AFPSGrenade::OnAcquiredFromPool()
+{
+	StartFuze();
+}
+
+void AFPSGrenade::OnReturnedToPool()
+{
+	GetWorldTimerManager().ClearTimer(FuzeTimerHandle);
+}
+
+void AFPSGrenade::OnMaterialized(float RemainingFuzeTime)
+{
+	// Pick up the fuze where the batched simulation left it
+	if (RemainingFuzeTime <= 0.0f)
+	{
+		OnExplode();
+		return;
+	}
+
+	GetWorldTimerManager().SetTimer(FuzeTimerHandle, this, &AFPSGrenade::OnExplode, RemainingFuzeTime, false);
+}
+
 void AFPSGrenade::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
 	// Only add impulse and destroy projectile if we hit a physics
@@ -71,35 +97,17 @@ void AFPSGrenade::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimi
 
 void AFPSGrenade::OnExplode()
 {
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSGrenadeExplode);
+
 	MakeNoise(1.0f, GetInstigator());
 
-	DrawDebugSphere(GetWorld(), GetActorLocation(), GrenadeRadius, 50, FColor::Red, false, 1.f, 0.f, 1.f);
-	
-	TArray<AActor*> OverlappingActors;
-	OuterSphereComponent->GetOverlappingActors(OverlappingActors);
-	for (int32 i = 0; i < OverlappingActors.Num(); i++)
+	FPS_DEBUG_SPHERE(GetWorld(), EFPSDebugCategory::Explosions, GetActorLocation(), GrenadeRadius, 16, FColor::Red, 1.f, 1.f);
+
+	// Bodies in the blast and their line of sight to it are resolved over the next frames, batched with every other explosion
+	UFPSExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<UFPSExplosionSubsystem>();
+	if (Explosions)
 	{
-		UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(OverlappingActors[i]->GetRootComponent());
-		if (PrimComp && PrimComp->IsSimulatingPhysics())
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Environment items overlapped with grenade zone!!"));
-
-			// the component we are looking for! It needs to be simulating in order to apply forces.
-
-			PrimComp->AddRadialImpulse(GetActorLocation(), GrenadeRadius, GrenadeForceStrength, ERadialImpulseFalloff::RIF_Constant, true);
-		}
-
-		ACharacter* Character = Cast<ACharacter>(OverlappingActors[i]);
-		if (Character)
-		{
-			UCharacterMovementComponent* CharacterComp = Cast<UCharacterMovementComponent>(Character->GetMovementComponent());
-			if (CharacterComp)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Character overlapped with grenade zone!!"));
-
-				CharacterComp->AddRadialImpulse(GetActorLocation(), GrenadeRadius, GrenadeForceStrength, ERadialImpulseFalloff::RIF_Constant, true);
-			}
-		}
+		Explosions->Explode(this, GetActorLocation(), GrenadeRadius, GrenadeForceStrength, ERadialImpulseFalloff::RIF_Constant);
 	}
 
 	if (ActivateGrenadeEffect)
@@ -110,5 +118,5 @@ void AFPSGrenade::OnExplode()
 	// Clear ALL timers that belong to this (Actor) instance.
 	GetWorldTimerManager().ClearAllTimersForObject(this);
 
-	Destroy();
-}
\ No newline at end of file
+	UFPSProjectilePoolSubsystem::ReturnOrDestroy(this);
+}
@@ -0,0 +1,355 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGuardCrowdSubsystem.h"
+#include "FPSGame.h"
+#include "FPSAIGuard.h"
+#include "FPSPatrolRoute.h"
+#include "Perception/PawnSensingComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Guard Crowd Tick"), STAT_FPSGuardCrowdTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Guards"), STAT_FPSCrowdGuards, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Guard Promotions"), STAT_FPSGuardPromotions, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<float> CVarGuardCrowdPromotionRadius(
+	TEXT("fps.GuardCrowd.PromotionRadius"),
+	16000.0f,
+	TEXT("Crowd guards within this distance of a player's view target are brought back as actors, keep it above the guards' replication cull distance so they never pop in on clients."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarGuardCrowdDemotionRadius(
+	TEXT("fps.GuardCrowd.DemotionRadius"),
+	18000.0f,
+	TEXT("Dormant guards only join the crowd with no player's view target within this distance, keep it above the promotion radius."),
+	ECVF_Default);
+
+/** Guards moved per parallel task */
+static const int32 GuardCrowdBatchSize = 64;
+
+void FFPSCrowdGuards::RemoveAtSwap(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	Speeds.RemoveAtSwap(Index, 1, false);
+	HeightOffsets.RemoveAtSwap(Index, 1, false);
+	HearingRanges.RemoveAtSwap(Index, 1, false);
+	RouteIndices.RemoveAtSwap(Index, 1, false);
+	Waypoints.RemoveAtSwap(Index, 1, false);
+	Promote.RemoveAtSwap(Index, 1, false);
+	Classes.RemoveAtSwap(Index, 1, false);
+	Actors.RemoveAtSwap(Index, 1, false);
+}
+
+void FFPSCrowdGuards::Reset()
+{
+	Positions.Reset();
+	Yaws.Reset();
+	Speeds.Reset();
+	HeightOffsets.Reset();
+	HearingRanges.Reset();
+	RouteIndices.Reset();
+	Waypoints.Reset();
+	Promote.Reset();
+	Classes.Reset();
+	Actors.Reset();
+}
+
+void UFPSGuardCrowdSubsystem::Deinitialize()
+{
+	Guards.Reset();
+	Routes.Empty();
+	PendingDemotions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSGuardCrowdSubsystem::QueueDemotion(AFPSAIGuard* Guard)
+{
+	if (Guard)
+	{
+		PendingDemotions.AddUnique(Guard);
+	}
+}
+
+void UFPSGuardCrowdSubsystem::CancelDemotion(AFPSAIGuard* Guard)
+{
+	PendingDemotions.RemoveSwap(Guard);
+}
+
+void UFPSGuardCrowdSubsystem::PromoteListeners(const FVector& Location, float Loudness, float MaxRange)
+{
+	for (int32 i = Guards.Num() - 1; i >= 0; i--)
+	{
+		float Reach = Guards.HearingRanges[i] * Loudness;
+		if (MaxRange > 0.0f)
+		{
+			Reach = FMath::Min(Reach, MaxRange);
+		}
+
+		if (FVector::DistSquared(Location, Guards.Positions[i]) <= FMath::Square(Reach))
+		{
+			Promote(i);
+		}
+	}
+}
+
+void UFPSGuardCrowdSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSGuardCrowdTick);
+
+	GatherPlayers();
+
+	const float PromotionRadius = CVarGuardCrowdPromotionRadius.GetValueOnGameThread();
+	const float DemotionRadius = FMath::Max(PromotionRadius, CVarGuardCrowdDemotionRadius.GetValueOnGameThread());
+
+	for (int32 i = PendingDemotions.Num() - 1; i >= 0; i--)
+	{
+		AFPSAIGuard* Guard = PendingDemotions[i].Get();
+		if (Guard == nullptr)
+		{
+			PendingDemotions.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		// Busy guards and ones a player could walk up to soon keep waiting, and every guard while nobody has a view target
+		// to measure from, all of them would look far away
+		if (!Guard->CanJoinCrowd() || PlayerLocations.Num() == 0 || IsPlayerWithin(Guard->GetActorLocation(), DemotionRadius))
+		{
+			continue;
+		}
+
+		// Out of the list first, destroying the guard cancels its demotion
+		PendingDemotions.RemoveAtSwap(i, 1, false);
+		Demote(Guard);
+	}
+
+	Simulate(DeltaTime, PromotionRadius);
+
+	int32 NumPromotions = 0;
+	for (int32 i = Guards.Num() - 1; i >= 0; i--)
+	{
+		if (Guards.Promote[i])
+		{
+			Promote(i);
+			NumPromotions++;
+		}
+	}
+
+	FPS_SET_COUNTER(STAT_FPSCrowdGuards, Guards.Num());
+	FPS_SET_COUNTER(STAT_FPSGuardPromotions, NumPromotions);
+}
+
+void UFPSGuardCrowdSubsystem::GatherPlayers()
+{
+	PlayerLocations.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		// Relevancy is measured from the view target, spectators and cameras included
+		const APlayerController* PC = It->Get();
+		const AActor* ViewTarget = PC ? PC->GetViewTarget() : nullptr;
+		if (ViewTarget)
+		{
+			PlayerLocations.Add(ViewTarget->GetActorLocation());
+		}
+	}
+}
+
+bool UFPSGuardCrowdSubsystem::IsPlayerWithin(const FVector& Location, float Radius) const
+{
+	return PlayerLocations.ContainsByPredicate([&Location, Radius](const FVector& PlayerLocation)
+	{
+		return FVector::DistSquared(Location, PlayerLocation) <= FMath::Square(Radius);
+	});
+}
+
+void UFPSGuardCrowdSubsystem::Demote(AFPSAIGuard* Guard)
+{
+	int32 RouteIndex = INDEX_NONE;
+	int32 Waypoint = INDEX_NONE;
+	if (Guard->GetPatrolRoute() && Guard->GetPatrolPointIndex() != INDEX_NONE)
+	{
+		RouteIndex = FindOrAddRoute(Guard->GetPatrolRoute());
+		Waypoint = Routes[RouteIndex].PointWaypoints[Guard->GetPatrolPointIndex()];
+	}
+
+	const UPawnSensingComponent* Sensing = Guard->GetPawnSensingComponent();
+
+	// Idle guards face their original rotation, patrolling ones are turned as they walk
+	Guards.Positions.Add(Guard->GetActorLocation());
+	Guards.Yaws.Add(Guard->GetActorRotation().Yaw);
+	Guards.Speeds.Add(Guard->GetCharacterMovement()->MaxWalkSpeed);
+	Guards.HeightOffsets.Add(Guard->GetCapsuleComponent()->GetScaledCapsuleHalfHeight());
+	Guards.HearingRanges.Add(FMath::Max(Sensing->HearingThreshold, Sensing->LOSHearingThreshold));
+	Guards.RouteIndices.Add(RouteIndex);
+	Guards.Waypoints.Add(Waypoint);
+	Guards.Promote.Add(0);
+	Guards.Classes.Add(Guard->GetClass());
+
+	UE_LOG(LogFPSAI, Verbose, TEXT("%s joined the guard crowd"), *Guard->GetName());
+
+	// A respawned placed guard would lose its instance edits and its net startup name, clients would see a second copy
+	if (Guard->IsNetStartupActor())
+	{
+		Guards.Actors.Add(Guard);
+		Guard->EnterCrowd();
+	}
+	else
+	{
+		Guards.Actors.Add(nullptr);
+		Guard->Destroy();
+	}
+}
+
+void UFPSGuardCrowdSubsystem::Simulate(float DeltaTime, float PromotionRadius)
+{
+	const int32 Num = Guards.Num();
+	FVector* RESTRICT Positions = Guards.Positions.GetData();
+	float* RESTRICT Yaws = Guards.Yaws.GetData();
+	int32* RESTRICT Waypoints = Guards.Waypoints.GetData();
+	uint8* RESTRICT Promote = Guards.Promote.GetData();
+	const float* RESTRICT Speeds = Guards.Speeds.GetData();
+	const float* RESTRICT HeightOffsets = Guards.HeightOffsets.GetData();
+	const int32* RESTRICT RouteIndices = Guards.RouteIndices.GetData();
+
+	const FFPSCrowdRoute* CrowdRoutes = Routes.GetData();
+	const FVector* Players = PlayerLocations.GetData();
+	const int32 NumPlayers = PlayerLocations.Num();
+	const float PromotionRadiusSq = FMath::Square(PromotionRadius);
+
+	// Every guard only touches its own slot, batches run on any worker
+	const int32 NumBatches = FMath::DivideAndRoundUp(Num, GuardCrowdBatchSize);
+	ParallelFor(NumBatches, [=](int32 Batch)
+	{
+		const int32 Last = FMath::Min(Num, (Batch + 1) * GuardCrowdBatchSize);
+		for (int32 i = Batch * GuardCrowdBatchSize; i < Last; i++)
+		{
+			if (RouteIndices[i] != INDEX_NONE)
+			{
+				const FFPSCrowdRoute& Route = CrowdRoutes[RouteIndices[i]];
+				const FVector Target = Route.Waypoints[Waypoints[i]] + FVector(0.0f, 0.0f, HeightOffsets[i]);
+
+				const FVector Delta = Target - Positions[i];
+				const float Distance = Delta.Size();
+				const float Step = Speeds[i] * DeltaTime;
+				if (Distance <= Step)
+				{
+					Positions[i] = Target;
+					Waypoints[i] = (Waypoints[i] + 1) % Route.Waypoints.Num();
+				}
+				else
+				{
+					Positions[i] += Delta * (Step / Distance);
+					Yaws[i] = FMath::RadiansToDegrees(FMath::Atan2(Delta.Y, Delta.X));
+				}
+			}
+
+			float BestDistSq = MAX_flt;
+			for (int32 Player = 0; Player < NumPlayers; Player++)
+			{
+				BestDistSq = FMath::Min(BestDistSq, FVector::DistSquared(Positions[i], Players[Player]));
+			}
+
+			Promote[i] = (BestDistSq <= PromotionRadiusSq) ? 1 : 0;
+		}
+	});
+}
+
+void UFPSGuardCrowdSubsystem::Promote(int32 Index)
+{
+	AFPSPatrolRoute* PatrolRoute = nullptr;
+	int32 PatrolPointIndex = INDEX_NONE;
+	const int32 RouteIndex = Guards.RouteIndices[Index];
+	if (RouteIndex != INDEX_NONE)
+	{
+		const FFPSCrowdRoute& Route = Routes[RouteIndex];
+		PatrolRoute = Route.Route.Get();
+		PatrolPointIndex = Route.PointIndices[Guards.Waypoints[Index]];
+	}
+
+	UWorld* World = GetWorld();
+	UClass* Class = Guards.Classes[Index].Get();
+	if (!Guards.Actors[Index].IsExplicitlyNull())
+	{
+		// Parked, gone for good if the level streamed out under it
+		AFPSAIGuard* Guard = Guards.Actors[Index].Get();
+		if (Guard)
+		{
+			Guard->LeaveCrowd(Guards.Positions[Index], FRotator(0.0f, Guards.Yaws[Index], 0.0f), PatrolRoute, PatrolPointIndex);
+
+			UE_LOG(LogFPSAI, Verbose, TEXT("%s left the guard crowd"), *Guard->GetName());
+		}
+	}
+	else if (Class)
+	{
+		const FTransform SpawnTransform(FRotator(0.0f, Guards.Yaws[Index], 0.0f), Guards.Positions[Index]);
+
+		AFPSAIGuard* Guard = World->SpawnActorDeferred<AFPSAIGuard>(Class, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+		if (Guard)
+		{
+			// Back on the route before BeginPlay starts the patrol
+			if (PatrolRoute)
+			{
+				Guard->SetPatrolStart(PatrolRoute, PatrolPointIndex);
+			}
+
+			Guard->FinishSpawning(SpawnTransform);
+
+			UE_LOG(LogFPSAI, Verbose, TEXT("%s left the guard crowd"), *Guard->GetName());
+		}
+	}
+
+	Guards.RemoveAtSwap(Index);
+}
+
+int32 UFPSGuardCrowdSubsystem::FindOrAddRoute(AFPSPatrolRoute* Route)
+{
+	const int32 Existing = Routes.IndexOfByPredicate([Route](const FFPSCrowdRoute& CrowdRoute) { return CrowdRoute.Route == Route; });
+	if (Existing != INDEX_NONE)
+	{
+		return Existing;
+	}
+
+	FFPSCrowdRoute& CrowdRoute = Routes.AddDefaulted_GetRef();
+	CrowdRoute.Route = Route;
+
+	// Each point followed by the inner points of its path, the path's end is the next point
+	for (int32 Point = 0; Point < Route->GetNumPoints(); Point++)
+	{
+		const TArray<FVector> Path = Route->GetPathFromPoint(Point);
+		const int32 NextPoint = Route->GetNextPointIndex(Point);
+
+		CrowdRoute.PointWaypoints.Add(CrowdRoute.Waypoints.Num());
+		CrowdRoute.Waypoints.Add(Path.Num() > 0 ? Path[0] : Route->GetPointLocation(Point));
+		CrowdRoute.PointIndices.Add(Point);
+
+		for (int32 i = 1; i < Path.Num() - 1; i++)
+		{
+			CrowdRoute.Waypoints.Add(Path[i]);
+			CrowdRoute.PointIndices.Add(NextPoint);
+		}
+	}
+
+	return Routes.Num() - 1;
+}
+
+ETickableTickType UFPSGuardCrowdSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSGuardCrowdSubsystem::IsTickable() const
+{
+	return Guards.Num() > 0 || PendingDemotions.Num() > 0;
+}
+
+TStatId UFPSGuardCrowdSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSGuardCrowdSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGuardThinkSubsystem.h"
+#include "FPSGame.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Guard Think Tick"), STAT_FPSGuardThinkTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Thinking Guards"), STAT_FPSThinkingGuards, STATGROUP_FPSGame);
+
+/** Guards evaluated per parallel task */
+static const int32 GuardThinkBatchSize = 32;
+
+void UFPSGuardThinkSubsystem::Deinitialize()
+{
+	AwakeGuards.Empty();
+	Thinkers.Empty();
+	Inputs.Empty();
+	Actions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSGuardThinkSubsystem::Wake(AFPSAIGuard* Guard)
+{
+	if (Guard)
+	{
+		AwakeGuards.AddUnique(Guard);
+	}
+}
+
+FFPSGuardThinkAction UFPSGuardThinkSubsystem::Think(const FFPSGuardThinkInput& Input, float Now)
+{
+	FFPSGuardThinkAction Action;
+	Action.NewState = Input.State;
+	Action.SuspiciousUntil = Input.SuspiciousUntil;
+
+	if (Input.bSawPawn)
+	{
+		// Spotted, stop patrolling for good
+		Action.NewState = EAIState::Alerted;
+		Action.bReportSpotted = true;
+		Action.bStopMovement = true;
+	}
+	else if (Input.bHeardNoise && Input.State != EAIState::Alerted)
+	{
+		// Look where it came from, stay suspicious for a while
+		FVector Direction = Input.NoiseLocation - Input.Location;
+		Direction.Normalize();
+
+		FRotator NewLookAt = FRotationMatrix::MakeFromX(Direction).Rotator();
+		NewLookAt.Pitch = 0.0f;
+		NewLookAt.Roll = 0.0f;
+
+		Action.NewState = EAIState::Suspicious;
+		Action.bSetRotation = true;
+		Action.Rotation = NewLookAt;
+		Action.SuspiciousUntil = Now + Input.SuspicionDuration;
+		Action.bStopMovement = true;
+	}
+	else if (Input.State == EAIState::Suspicious && Now >= Input.SuspiciousUntil)
+	{
+		// Stopped investigating...if we are a patrolling pawn, go back to the point we were heading for
+		Action.NewState = EAIState::Idle;
+		Action.bSetRotation = true;
+		Action.Rotation = Input.OriginalRotation;
+		Action.bResumePatrol = true;
+	}
+
+	Action.bStayAwake = (Action.NewState == EAIState::Suspicious);
+	return Action;
+}
+
+void UFPSGuardThinkSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSGuardThinkTick);
+
+	// Gather on the game thread, the guards are not touched again until the commit
+	Thinkers.Reset();
+	Inputs.Reset();
+	for (const TWeakObjectPtr<AFPSAIGuard>& WeakGuard : AwakeGuards)
+	{
+		AFPSAIGuard* Guard = WeakGuard.Get();
+		if (Guard)
+		{
+			Thinkers.Add(Guard);
+			Guard->GetThinkInput(Inputs.AddDefaulted_GetRef());
+		}
+	}
+
+	AwakeGuards.Reset();
+
+	const int32 Num = Inputs.Num();
+	Actions.SetNumUninitialized(Num, false);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	const FFPSGuardThinkInput* ThinkInputs = Inputs.GetData();
+	FFPSGuardThinkAction* ThinkActions = Actions.GetData();
+
+	const int32 NumBatches = FMath::DivideAndRoundUp(Num, GuardThinkBatchSize);
+	ParallelFor(NumBatches, [=](int32 Batch)
+	{
+		const int32 Last = FMath::Min(Num, (Batch + 1) * GuardThinkBatchSize);
+		for (int32 i = Batch * GuardThinkBatchSize; i < Last; i++)
+		{
+			ThinkActions[i] = Think(ThinkInputs[i], Now);
+		}
+	});
+
+	// Commits may wake guards again, those think next frame
+	for (int32 i = 0; i < Num; i++)
+	{
+		// Destroyed by an earlier commit
+		if (Thinkers[i]->IsPendingKill())
+		{
+			continue;
+		}
+
+		if (Actions[i].bStayAwake)
+		{
+			AwakeGuards.AddUnique(Thinkers[i]);
+		}
+
+		Thinkers[i]->CommitThink(Actions[i]);
+	}
+
+	FPS_SET_COUNTER(STAT_FPSThinkingGuards, Num);
+}
+
+ETickableTickType UFPSGuardThinkSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSGuardThinkSubsystem::IsTickable() const
+{
+	return AwakeGuards.Num() > 0;
+}
+
+TStatId UFPSGuardThinkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSGuardThinkSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSHitscanSubsystem.h"
+#include "FPSGame.h"
+#include "FPSLagCompensationSubsystem.h"
+#include "GameFramework/Character.h"
+#include "FPSAIGuard.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "FPSDebugDrawSubsystem.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hitscan Tick"), STAT_FPSHitscanTick, STATGROUP_FPSGame);
+
+void UFPSHitscanSubsystem::Deinitialize()
+{
+	QueuedShots.Empty();
+	InFlightShots.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSHitscanSubsystem::QueueShot(AActor* Shooter, AActor* IgnoredActor, const FVector& Start, const FVector& Direction, float Distance, float Timestamp, ECollisionChannel TraceChannel, float Impulse, AActor* NoiseMaker, float NoiseLoudness)
+{
+	FFPSHitscanShot& Shot = QueuedShots.AddDefaulted_GetRef();
+	Shot.Shooter = Shooter;
+	Shot.IgnoredActor = IgnoredActor;
+	Shot.Start = Start;
+	Shot.Direction = Direction.GetSafeNormal();
+	Shot.Distance = Distance;
+	Shot.Timestamp = Timestamp;
+	Shot.TraceChannel = TraceChannel;
+	Shot.Impulse = Impulse;
+	Shot.NoiseMaker = NoiseMaker;
+	Shot.NoiseLoudness = NoiseLoudness;
+}
+
+void UFPSHitscanSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSHitscanTick);
+
+	// Shots traced last frame first, the ones queued this frame are issued after
+	for (int32 i = InFlightShots.Num() - 1; i >= 0; i--)
+	{
+		if (TryResolveShot(InFlightShots[i]))
+		{
+			InFlightShots.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	IssueShots();
+}
+
+void UFPSHitscanSubsystem::IssueShots()
+{
+	UWorld* World = GetWorld();
+	UFPSLagCompensationSubsystem* LagCompensation = World->GetSubsystem<UFPSLagCompensationSubsystem>();
+
+	for (FFPSHitscanShot& Shot : QueuedShots)
+	{
+		// additional trace parameters
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSHitscan), false, Shot.Shooter.Get());
+		QueryParams.AddIgnoredActor(Shot.IgnoredActor.Get());
+
+		// Characters are tested as rewound hitboxes when the shot resolves
+		if (LagCompensation)
+		{
+			LagCompensation->AddIgnoredCharacters(QueryParams);
+		}
+
+		Shot.TraceHandle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Shot.Start, Shot.Start + Shot.Direction * Shot.Distance, Shot.TraceChannel, QueryParams);
+
+		InFlightShots.Add(Shot);
+	}
+
+	QueuedShots.Reset();
+}
+
+bool UFPSHitscanSubsystem::TryResolveShot(const FFPSHitscanShot& Shot)
+{
+	UWorld* World = GetWorld();
+
+	FTraceDatum Datum;
+	if (!World->QueryTraceData(Shot.TraceHandle, Datum))
+	{
+		// Still running, unless the result was dropped, in which case the shot is lost
+		return !World->IsTraceHandleValid(Shot.TraceHandle, false);
+	}
+
+	const FVector TraceEnd = Shot.Start + Shot.Direction * Shot.Distance;
+
+	FHitResult Hit;
+	const FHitResult* WorldHit = Datum.OutHits.FindByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; });
+	if (WorldHit)
+	{
+		Hit = *WorldHit;
+	}
+
+	bool bIsHit = (WorldHit != nullptr);
+
+	UFPSLagCompensationSubsystem* LagCompensation = World->GetSubsystem<UFPSLagCompensationSubsystem>();
+	if (LagCompensation)
+	{
+		bIsHit |= LagCompensation->TraceHitboxes(Shot.Start, TraceEnd, Shot.Timestamp, Shot.Shooter.Get(), WorldHit ? WorldHit->Distance : MAX_flt, Hit);
+	}
+
+	// Guards hear the shot where it landed, or where it was fired from when it hit nothing
+	AActor* NoiseMaker = Shot.NoiseMaker.Get();
+	if (NoiseMaker && Shot.NoiseLoudness > 0.0f)
+	{
+		NoiseMaker->MakeNoise(Shot.NoiseLoudness, Cast<APawn>(Shot.Shooter.Get()), bIsHit ? Hit.ImpactPoint : Shot.Start);
+	}
+
+	if (bIsHit)
+	{
+		ApplyHit(Shot, Hit);
+	}
+	else
+	{
+		FPS_LOG_THROTTLED(LogFPSWeapons, Verbose, 0.5, TEXT("Nothing was hit"));
+		// start to end, purple, seconds drawn, thickness of line
+		FPS_DEBUG_LINE(World, EFPSDebugCategory::Weapons, Shot.Start, TraceEnd, FColor::Purple, 5.f, 1.f);
+	}
+
+	return true;
+}
+
+void UFPSHitscanSubsystem::ApplyHit(const FFPSHitscanShot& Shot, const FHitResult& Hit)
+{
+	// start to end, green, seconds drawn, thickness of line
+	FPS_DEBUG_LINE(GetWorld(), EFPSDebugCategory::Weapons, Shot.Start, Shot.Start + Shot.Direction * Shot.Distance, FColor::Green, 5.f, 1.f);
+
+	AActor* HitActor = Hit.GetActor();
+	if (HitActor == nullptr)
+	{
+		return;
+	}
+
+	FPS_LOG_THROTTLED(LogFPSWeapons, Verbose, 0.5, TEXT("Hit actor name %s, distance %.1f"), *HitActor->GetName(), Hit.Distance);
+	FPS_DEBUG_BOX(GetWorld(), EFPSDebugCategory::Weapons, Hit.ImpactPoint, FVector(10.f, 10.f, 10.f), FColor::Red, 5.f, 5.f);
+
+	UPrimitiveComponent* PrimComp = Cast<UPrimitiveComponent>(HitActor->GetRootComponent());
+	if (PrimComp && PrimComp->IsSimulatingPhysics())
+	{
+		PrimComp->AddImpulseAtLocation(Shot.Direction * Shot.Impulse * PrimComp->GetMass(), Hit.ImpactPoint);
+	}
+
+	// Same push as a physics body gets
+	ACharacter* HitCharacter = Cast<ACharacter>(HitActor);
+	if (HitCharacter && HitCharacter->GetCharacterMovement())
+	{
+		HitCharacter->GetCharacterMovement()->AddImpulse(Shot.Direction * Shot.Impulse, true);
+
+		AFPSAIGuard* HitGuard = Cast<AFPSAIGuard>(HitCharacter);
+		if (HitGuard)
+		{
+			HitGuard->WakeForMovement();
+		}
+	}
+}
+
+ETickableTickType UFPSHitscanSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSHitscanSubsystem::IsTickable() const
+{
+	return QueuedShots.Num() > 0 || InFlightShots.Num() > 0;
+}
+
+TStatId UFPSHitscanSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSHitscanSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSLagCompensationSubsystem.h"
+#include "FPSGame.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Tick"), STAT_FPSLagCompensationTick, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<int32> CVarLagCompensationHistorySize(
+	TEXT("fps.LagCompensation.HistorySize"),
+	64,
+	TEXT("Number of server frames of hitboxes kept per character, read when the character registers."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarLagCompensationMaxRewind(
+	TEXT("fps.LagCompensation.MaxRewind"),
+	0.4f,
+	TEXT("Furthest back in seconds a shot can be rewound, older timestamps are clamped. 0 disables rewinding."),
+	ECVF_Default);
+
+/** Limbs reach out of the capsule, it is grown by this much when it only gates the body traces */
+static const float HitboxBroadPhaseMargin = 40.0f;
+
+int32 FFPSHitboxHistory::Record(const FFPSHitboxSnapshot& Snapshot)
+{
+	const int32 Slot = Head;
+	Snapshots[Slot] = Snapshot;
+	Head = (Head + 1) % Snapshots.Num();
+	Num = FMath::Min(Num + 1, Snapshots.Num());
+	return Slot;
+}
+
+bool FFPSHitboxHistory::FindSlots(float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const
+{
+	if (Num == 0)
+	{
+		return false;
+	}
+
+	const int32 Capacity = Snapshots.Num();
+
+	// Walk back from the newest snapshot until we pass Time
+	int32 Newer = (Head - 1 + Capacity) % Capacity;
+	if (Time >= Snapshots[Newer].Time)
+	{
+		OutOlder = Newer;
+		OutNewer = Newer;
+		OutAlpha = 0.0f;
+		return true;
+	}
+
+	for (int32 i = 2; i <= Num; i++)
+	{
+		const int32 Older = (Head - i + Capacity) % Capacity;
+		if (Snapshots[Older].Time <= Time)
+		{
+			OutOlder = Older;
+			OutNewer = Newer;
+			OutAlpha = (Time - Snapshots[Older].Time) / FMath::Max(Snapshots[Newer].Time - Snapshots[Older].Time, KINDA_SMALL_NUMBER);
+			return true;
+		}
+
+		Newer = Older;
+	}
+
+	// Older than the whole history
+	OutOlder = Newer;
+	OutNewer = Newer;
+	OutAlpha = 0.0f;
+	return true;
+}
+
+FFPSHitboxSnapshot FFPSHitboxHistory::SampleCapsule(int32 Older, int32 Newer, float Alpha) const
+{
+	if (Older == Newer)
+	{
+		return Snapshots[Newer];
+	}
+
+	FFPSHitboxSnapshot Snapshot;
+	Snapshot.Time = FMath::Lerp(Snapshots[Older].Time, Snapshots[Newer].Time, Alpha);
+	Snapshot.Location = FMath::Lerp(Snapshots[Older].Location, Snapshots[Newer].Location, Alpha);
+	Snapshot.Radius = FMath::Lerp(Snapshots[Older].Radius, Snapshots[Newer].Radius, Alpha);
+	Snapshot.HalfHeight = FMath::Lerp(Snapshots[Older].HalfHeight, Snapshots[Newer].HalfHeight, Alpha);
+	return Snapshot;
+}
+
+FTransform FFPSHitboxHistory::SampleBody(int32 Older, int32 Newer, float Alpha, int32 Body) const
+{
+	if (Older == Newer)
+	{
+		return BodyTransforms[Newer * NumBodies + Body];
+	}
+
+	FTransform Transform;
+	Transform.Blend(BodyTransforms[Older * NumBodies + Body], BodyTransforms[Newer * NumBodies + Body], Alpha);
+	return Transform;
+}
+
+void UFPSLagCompensationSubsystem::Deinitialize()
+{
+	Histories.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSLagCompensationSubsystem::Register(ACharacter* Character)
+{
+	if (Character == nullptr || Histories.ContainsByPredicate([Character](const FFPSHitboxHistory& History) { return History.Character == Character; }))
+	{
+		return;
+	}
+
+	FFPSHitboxHistory& History = Histories.AddDefaulted_GetRef();
+	History.Character = Character;
+	History.Snapshots.SetNumZeroed(FMath::Max(2, CVarLagCompensationHistorySize.GetValueOnGameThread()));
+
+	const USkeletalMeshComponent* Mesh = Character->GetMesh();
+	History.NumBodies = Mesh ? Mesh->Bodies.Num() : 0;
+	History.BodyTransforms.SetNum(History.Snapshots.Num() * History.NumBodies);
+}
+
+void UFPSLagCompensationSubsystem::Unregister(ACharacter* Character)
+{
+	const int32 Index = Histories.IndexOfByPredicate([Character](const FFPSHitboxHistory& History) { return History.Character == Character; });
+	if (Index != INDEX_NONE)
+	{
+		Histories.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+void UFPSLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSLagCompensationTick);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	for (int32 i = Histories.Num() - 1; i >= 0; i--)
+	{
+		ACharacter* Character = Histories[i].Character.Get();
+		if (Character == nullptr)
+		{
+			Histories.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		const UCapsuleComponent* Capsule = Character->GetCapsuleComponent();
+
+		FFPSHitboxSnapshot Snapshot;
+		Snapshot.Time = Now;
+		Snapshot.Location = Capsule->GetComponentLocation();
+		Snapshot.Radius = Capsule->GetScaledCapsuleRadius();
+		Snapshot.HalfHeight = Capsule->GetScaledCapsuleHalfHeight();
+
+		FFPSHitboxHistory& History = Histories[i];
+		const int32 Slot = History.Record(Snapshot);
+
+		// A mesh swapped for one with other bodies falls back to its capsule, see TraceHitboxes
+		const USkeletalMeshComponent* Mesh = Character->GetMesh();
+		if (History.NumBodies > 0 && Mesh && Mesh->Bodies.Num() == History.NumBodies)
+		{
+			FTransform* RESTRICT BodyTransforms = History.BodyTransforms.GetData() + Slot * History.NumBodies;
+			for (int32 Body = 0; Body < History.NumBodies; Body++)
+			{
+				const FBodyInstance* BodyInstance = Mesh->Bodies[Body];
+				BodyTransforms[Body] = BodyInstance ? BodyInstance->GetUnrealWorldTransform() : Mesh->GetComponentTransform();
+			}
+		}
+	}
+}
+
+bool UFPSLagCompensationSubsystem::RewindTrace(const FVector& Start, const FVector& End, float Timestamp, const AActor* Shooter, FHitResult& OutHit) const
+{
+	// Everything but the registered characters, their current hitboxes are replaced by the rewound ones
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSRewindTrace), false, Shooter);
+	AddIgnoredCharacters(QueryParams);
+
+	const bool bWorldHit = GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, COLLISION_HITBOX, QueryParams);
+
+	return TraceHitboxes(Start, End, Timestamp, Shooter, bWorldHit ? OutHit.Distance : MAX_flt, OutHit) || bWorldHit;
+}
+
+float UFPSLagCompensationSubsystem::ClampTimestamp(float Timestamp) const
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	return FMath::Clamp(Timestamp, Now - FMath::Max(0.0f, CVarLagCompensationMaxRewind.GetValueOnGameThread()), Now);
+}
+
+void UFPSLagCompensationSubsystem::AddIgnoredCharacters(FCollisionQueryParams& QueryParams) const
+{
+	for (const FFPSHitboxHistory& History : Histories)
+	{
+		QueryParams.AddIgnoredActor(History.Character.Get());
+	}
+}
+
+bool UFPSLagCompensationSubsystem::TraceHitboxes(const FVector& Start, const FVector& End, float Timestamp, const AActor* Shooter, float MaxDistance, FHitResult& OutHit) const
+{
+	const float RewindTime = ClampTimestamp(Timestamp);
+
+	const FVector TraceDir = (End - Start).GetSafeNormal();
+
+	float BestDistance = MaxDistance;
+	bool bHit = false;
+	for (const FFPSHitboxHistory& History : Histories)
+	{
+		ACharacter* Character = History.Character.Get();
+		int32 Older;
+		int32 Newer;
+		float Alpha;
+		if (Character == nullptr || Character == Shooter || !History.FindSlots(RewindTime, Older, Newer, Alpha))
+		{
+			continue;
+		}
+
+		const FFPSHitboxSnapshot Snapshot = History.SampleCapsule(Older, Newer, Alpha);
+
+		USkeletalMeshComponent* Mesh = Character->GetMesh();
+		const bool bTraceBodies = History.NumBodies > 0 && Mesh && Mesh->IsQueryCollisionEnabled() && Mesh->Bodies.Num() == History.NumBodies;
+		const float Radius = Snapshot.Radius + (bTraceBodies ? HitboxBroadPhaseMargin : 0.0f);
+		const float HalfHeight = Snapshot.HalfHeight + (bTraceBodies ? HitboxBroadPhaseMargin : 0.0f);
+
+		// Closest points between the trace and the capsule's axis
+		const FVector AxisOffset(0.0f, 0.0f, HalfHeight - Radius);
+		FVector OnTrace;
+		FVector OnAxis;
+		FMath::SegmentDistToSegmentSafe(Start, End, Snapshot.Location - AxisOffset, Snapshot.Location + AxisOffset, OnTrace, OnAxis);
+
+		const float DistSq = FVector::DistSquared(OnTrace, OnAxis);
+		if (DistSq > FMath::Square(Radius))
+		{
+			continue;
+		}
+
+		if (bTraceBodies)
+		{
+			if (TraceBodies(History, Mesh, Older, Newer, Alpha, Start, End, BestDistance, OutHit))
+			{
+				BestDistance = OutHit.Distance;
+				bHit = true;
+			}
+			continue;
+		}
+
+		// Step back from the closest point to where the trace enters the capsule
+		const float Distance = FMath::Max(0.0f, FVector::Dist(Start, OnTrace) - FMath::Sqrt(FMath::Square(Radius) - DistSq));
+		if (Distance >= BestDistance)
+		{
+			continue;
+		}
+
+		// Report the hit on the character as it is now so impulses and effects land where the target actually is
+		const FVector RewindOffset = Character->GetCapsuleComponent()->GetComponentLocation() - Snapshot.Location;
+
+		OutHit = FHitResult(Character, Character->GetCapsuleComponent(), Start + TraceDir * Distance + RewindOffset, -TraceDir);
+		OutHit.bBlockingHit = true;
+		OutHit.Distance = Distance;
+		OutHit.Time = Distance / FMath::Max(FVector::Dist(Start, End), KINDA_SMALL_NUMBER);
+		OutHit.TraceStart = Start;
+		OutHit.TraceEnd = End;
+
+		BestDistance = Distance;
+		bHit = true;
+	}
+
+	return bHit;
+}
+
+bool UFPSLagCompensationSubsystem::TraceBodies(const FFPSHitboxHistory& History, USkeletalMeshComponent* Mesh, int32 Older, int32 Newer, float Alpha, const FVector& Start, const FVector& End, float MaxDistance, FHitResult& OutHit) const
+{
+	const float TraceLength = FVector::Dist(Start, End);
+
+	float BestDistance = MaxDistance;
+	bool bHit = false;
+	for (int32 Body = 0; Body < History.NumBodies; Body++)
+	{
+		const FBodyInstance* BodyInstance = Mesh->Bodies[Body];
+		if (BodyInstance == nullptr || BodyInstance->GetResponseToChannel(COLLISION_HITBOX) != ECR_Block)
+		{
+			continue;
+		}
+
+		// Into the space of the body as it was, then out of the body as it is now. The shape is traced where it is, and the hit
+		// lands on the target as it is now so impulses and effects line up
+		const FTransform Rewound = History.SampleBody(Older, Newer, Alpha, Body);
+		const FTransform Current = BodyInstance->GetUnrealWorldTransform();
+		const FVector BodyStart = Current.TransformPosition(Rewound.InverseTransformPosition(Start));
+		const FVector BodyEnd = Current.TransformPosition(Rewound.InverseTransformPosition(End));
+
+		FHitResult BodyHit;
+		if (!BodyInstance->LineTrace(BodyHit, BodyStart, BodyEnd, false))
+		{
+			continue;
+		}
+
+		const float Distance = BodyHit.Time * TraceLength;
+		if (Distance >= BestDistance)
+		{
+			continue;
+		}
+
+		OutHit = BodyHit;
+		OutHit.bBlockingHit = true;
+		OutHit.Actor = Mesh->GetOwner();
+		OutHit.Component = Mesh;
+		OutHit.BoneName = BodyInstance->BodySetup.IsValid() ? BodyInstance->BodySetup->BoneName : NAME_None;
+		OutHit.Distance = Distance;
+		OutHit.TraceStart = Start;
+		OutHit.TraceEnd = End;
+
+		BestDistance = Distance;
+		bHit = true;
+	}
+
+	return bHit;
+}
+
+ETickableTickType UFPSLagCompensationSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSLagCompensationSubsystem::IsTickable() const
+{
+	return Histories.Num() > 0;
+}
+
+TStatId UFPSLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSLagCompensationSubsystem, STATGROUP_Tickables);
+}
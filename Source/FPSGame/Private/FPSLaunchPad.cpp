@@ -2,11 +2,13 @@
 
 
 #include "FPSLaunchPad.h"
+#include "FPSGame.h"
 #include "Components/BoxComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "Components/DecalComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "GameFramework/Character.h"
+#include "FPSAIGuard.h"
 
 // Sets default values
 AFPSLaunchPad::AFPSLaunchPad()
@@ -48,10 +50,16 @@ void AFPSLaunchPad::HandleOverlap(UPrimitiveComponent* OverlappedComponent, AAct
 	{
 		OtherCharacter->LaunchCharacter(LaunchVelocity, true, true);
 
+		AFPSAIGuard* OtherGuard = Cast<AFPSAIGuard>(OtherCharacter);
+		if (OtherGuard)
+		{
+			OtherGuard->WakeForMovement();
+		}
+
 		PlayEffects();
 		PlaySounds();
 
-		UE_LOG(LogTemp, Log, TEXT("Character overlapped with launchpad zone!!"));
+		FPS_LOG_THROTTLED(LogFPSPhysics, Verbose, 1.0, TEXT("Character overlapped with launchpad zone!!"));
 	}
 	else if (OtherComp && OtherComp->IsSimulatingPhysics())
 	{
@@ -60,7 +68,7 @@ void AFPSLaunchPad::HandleOverlap(UPrimitiveComponent* OverlappedComponent, AAct
 		PlayEffects();
 		PlaySounds();
 
-		UE_LOG(LogTemp, Log, TEXT("Physics object overlapped with launchpad zone!!"));
+		FPS_LOG_THROTTLED(LogFPSPhysics, Verbose, 1.0, TEXT("Physics object overlapped with launchpad zone!!"));
 	}
 }
 
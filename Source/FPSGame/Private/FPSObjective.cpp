@@ -20,6 +20,9 @@ AFPSObjective::AFPSObjective()
 	SphereComp->SetupAttachment(MeshComp);
 
 	SetReplicates(true);
+
+	// Nothing replicated changes until it is picked up and destroyed, clients already have it from the level
+	NetDormancy = DORM_Initial;
 }
 
 // Called when the game starts or when spawned
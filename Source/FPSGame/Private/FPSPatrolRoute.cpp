@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSPatrolRoute.h"
+#include "FPSGame.h"
+#include "Components/SceneComponent.h"
+#include "NavigationSystem.h"
+#include "NavigationPath.h"
+
+AFPSPatrolRoute::AFPSPatrolRoute()
+{
+	SceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
+	RootComponent = SceneComponent;
+}
+
+void AFPSPatrolRoute::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Routes placed or edited without baking get their paths once here instead of once per guard
+	if (HasAuthority())
+	{
+		BuildPaths();
+	}
+}
+
+FVector AFPSPatrolRoute::GetPointLocation(int32 Index) const
+{
+	return GetActorTransform().TransformPosition(Points[Index]);
+}
+
+TArray<FVector> AFPSPatrolRoute::GetPathFromPoint(int32 Index)
+{
+	if (!Points.IsValidIndex(Index))
+	{
+		return TArray<FVector>();
+	}
+
+	if (Segments.Num() != Points.Num() || !IsSegmentUpToDate(Index))
+	{
+		BuildPaths();
+	}
+
+	return Segments[Index].PathPoints;
+}
+
+bool AFPSPatrolRoute::IsSegmentUpToDate(int32 Index) const
+{
+	const FFPSPatrolSegment& Segment = Segments[Index];
+	return Segment.PathPoints.Num() > 0
+		&& Segment.Start.Equals(GetPointLocation(Index))
+		&& Segment.End.Equals(GetPointLocation(GetNextPointIndex(Index)));
+}
+
+void AFPSPatrolRoute::BuildPaths()
+{
+	// Points added or removed since the last bake, every segment past the first change is rebuilt by the checks below
+	Segments.SetNum(Points.Num());
+
+	for (int32 i = 0; i < Points.Num(); i++)
+	{
+		if (IsSegmentUpToDate(i))
+		{
+			continue;
+		}
+
+		FFPSPatrolSegment& Segment = Segments[i];
+		Segment.Start = GetPointLocation(i);
+		Segment.End = GetPointLocation(GetNextPointIndex(i));
+		Segment.PathPoints.Reset();
+
+		UNavigationPath* Path = UNavigationSystemV1::FindPathToLocationSynchronously(this, Segment.Start, Segment.End, this);
+		if (Path && Path->IsValid() && !Path->IsPartial())
+		{
+			Segment.PathPoints = Path->PathPoints;
+		}
+		else
+		{
+			UE_LOG(LogFPSAI, Warning, TEXT("%s has no navmesh path from point %d to the next, guards will walk straight"), *GetName(), i);
+			Segment.PathPoints.Add(Segment.Start);
+			Segment.PathPoints.Add(Segment.End);
+		}
+	}
+}
@@ -0,0 +1,570 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSPerceptionSubsystem.h"
+#include "FPSGame.h"
+#include "FPSGuardCrowdSubsystem.h"
+#include "FPSVisibilityGrid.h"
+#include "Perception/PawnSensingComponent.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Perception Tick"), STAT_FPSPerceptionTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sight Traces"), STAT_FPSSightTraces, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Noises"), STAT_FPSNoises, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visibility Rejections"), STAT_FPSVisibilityRejections, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<float> CVarPerceptionCellSize(
+	TEXT("fps.Perception.CellSize"),
+	2000.0f,
+	TEXT("Size of the grid cells pawns are bucketed into for sight."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarPerceptionNoiseInterval(
+	TEXT("fps.Perception.NoiseInterval"),
+	0.5f,
+	TEXT("Shortest time between two routed noises of the same instigator made at about the same place, unless the second is louder. Its own noises and those of what it set off are throttled apart. Matches the default sensing interval."),
+	ECVF_Default);
+
+/** A noise further than this from the last one of its slot is never throttled, a shot landing elsewhere is a new noise */
+static const float NoiseThrottleRadius = 500.0f;
+
+int32 UFPSPerceptionSubsystem::NumNoiseRoutingSubsystems = 0;
+
+void FFPSPerceptionTargets::Reset()
+{
+	X.Reset();
+	Y.Reset();
+	Z.Reset();
+	Pawns.Reset();
+	NextInCell.Reset();
+}
+
+void UFPSPerceptionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Shared by every world, RouteNoise finds the subsystem of the world the noise is made in
+	if (NumNoiseRoutingSubsystems++ == 0)
+	{
+		AActor::SetMakeNoiseDelegate(FMakeNoiseDelegate::CreateStatic(&UFPSPerceptionSubsystem::RouteNoise));
+	}
+}
+
+void UFPSPerceptionSubsystem::Deinitialize()
+{
+	// AActor keeps its delegate private, so the handler put back is the engine default that RouteNoise forwards to
+	if (--NumNoiseRoutingSubsystems == 0)
+	{
+		AActor::SetMakeNoiseDelegate(FMakeNoiseDelegate::CreateStatic(&AActor::MakeNoiseImpl));
+	}
+
+
+	Observers.Empty();
+	Queries.Empty();
+	Targets.Reset();
+	CellHeads.Empty();
+	NoiseEvents.Empty();
+	LastNoises.Empty();
+	HearingQueries.Empty();
+	HeardNoises.Empty();
+	ListenerCellHeads.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSPerceptionSubsystem::RegisterObserver(UPawnSensingComponent* Sensing)
+{
+	if (Sensing == nullptr || Observers.ContainsByPredicate([Sensing](const FFPSPerceptionObserver& Observer) { return Observer.Sensing == Sensing; }))
+	{
+		return;
+	}
+
+	FFPSPerceptionObserver& Observer = Observers.AddDefaulted_GetRef();
+	Observer.Sensing = Sensing;
+	Observer.bSeePawns = Sensing->bSeePawns;
+	Observer.bHearNoises = Sensing->bHearNoises;
+
+	// Spread the first updates so guards spawned together don't all look on the same frame
+	Observer.NextSenseTime = GetWorld()->GetTimeSeconds() + FMath::FRand() * Sensing->SensingInterval;
+
+	Sensing->bSeePawns = false;
+	Sensing->bHearNoises = false;
+}
+
+void UFPSPerceptionSubsystem::UnregisterObserver(UPawnSensingComponent* Sensing)
+{
+	const int32 Index = Observers.IndexOfByPredicate([Sensing](const FFPSPerceptionObserver& Observer) { return Observer.Sensing == Sensing; });
+	if (Index != INDEX_NONE)
+	{
+		// Hand the settings back, a component registered again later reads them from itself
+		if (Sensing)
+		{
+			Sensing->bSeePawns = Observers[Index].bSeePawns;
+			Sensing->bHearNoises = Observers[Index].bHearNoises;
+		}
+
+		Observers.RemoveAtSwap(Index, 1, false);
+	}
+}
+
+void UFPSPerceptionSubsystem::SetObserverSightEnabled(UPawnSensingComponent* Sensing, bool bEnabled)
+{
+	FFPSPerceptionObserver* Observer = Observers.FindByPredicate([Sensing](const FFPSPerceptionObserver& Observer) { return Observer.Sensing == Sensing; });
+	if (Observer)
+	{
+		Observer->bSightEnabled = bEnabled;
+	}
+}
+
+void UFPSPerceptionSubsystem::RouteNoise(AActor* NoiseMaker, float Loudness, APawn* NoiseInstigator, const FVector& NoiseLocation, float MaxRange, FName Tag)
+{
+	// Still goes to the instigator's noise emitter for anything else listening to it
+	AActor::MakeNoiseImpl(NoiseMaker, Loudness, NoiseInstigator, NoiseLocation, MaxRange, Tag);
+
+	UWorld* World = NoiseMaker ? NoiseMaker->GetWorld() : nullptr;
+	UFPSPerceptionSubsystem* Perception = World ? World->GetSubsystem<UFPSPerceptionSubsystem>() : nullptr;
+	if (Perception)
+	{
+		Perception->ReportNoise(NoiseMaker, NoiseInstigator, NoiseLocation, Loudness, MaxRange);
+	}
+}
+
+void UFPSPerceptionSubsystem::ReportNoise(AActor* NoiseMaker, APawn* Instigator, const FVector& Location, float Loudness, float MaxRange)
+{
+	if (Instigator == nullptr || Loudness <= 0.0f)
+	{
+		return;
+	}
+
+	// Footsteps, bounces and automatic fire report far more noises than listeners sample, keep the first, any louder one and
+	// any made elsewhere. A pawn's own noises don't hide the bounce of its grenade or the other way round
+	const float Now = GetWorld()->GetTimeSeconds();
+	FFPSNoiseRecord& Record = LastNoises.FindOrAdd(Instigator);
+	FFPSNoiseSlot& LastNoise = (NoiseMaker == Instigator) ? Record.Local : Record.Remote;
+	if (Now < LastNoise.Time + CVarPerceptionNoiseInterval.GetValueOnGameThread()
+		&& Loudness <= LastNoise.Loudness
+		&& FVector::DistSquared(Location, LastNoise.Location) <= FMath::Square(NoiseThrottleRadius))
+	{
+		return;
+	}
+
+	LastNoise.Time = Now;
+	LastNoise.Loudness = Loudness;
+	LastNoise.Location = Location;
+
+	FFPSNoiseEvent& Noise = NoiseEvents.AddDefaulted_GetRef();
+	Noise.Instigator = Instigator;
+	Noise.Location = Location;
+	Noise.Loudness = Loudness;
+	Noise.MaxRange = MaxRange;
+}
+
+void UFPSPerceptionSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSPerceptionTick);
+
+	ResolveQueries();
+	ResolveHearingQueries();
+
+	NumVisibilityRejections = 0;
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float CellSize = FMath::Max(100.0f, CVarPerceptionCellSize.GetValueOnGameThread());
+
+	bool bGridBuilt = false;
+	for (int32 i = Observers.Num() - 1; i >= 0; i--)
+	{
+		FFPSPerceptionObserver& Observer = Observers[i];
+
+		UPawnSensingComponent* Sensing = Observer.Sensing.Get();
+		if (Sensing == nullptr)
+		{
+			Observers.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		if (!Observer.bSightEnabled || !Observer.bSeePawns || Observer.NextSenseTime > Now)
+		{
+			continue;
+		}
+
+		Observer.NextSenseTime = Now + Sensing->SensingInterval;
+
+		// Only bucket the pawns on frames where someone looks
+		if (!bGridBuilt)
+		{
+			BuildGrid(CellSize);
+			bGridBuilt = true;
+		}
+
+		SenseFrom(Sensing, CellSize);
+	}
+
+	FPS_SET_COUNTER(STAT_FPSSightTraces, Queries.Num());
+	FPS_SET_COUNTER(STAT_FPSNoises, NoiseEvents.Num());
+
+	if (NoiseEvents.Num() > 0)
+	{
+		// Crowd guards that would hear a noise are spawned back first, so it reaches them with the other listeners
+		UFPSGuardCrowdSubsystem* Crowd = GetWorld()->GetSubsystem<UFPSGuardCrowdSubsystem>();
+		if (Crowd)
+		{
+			for (const FFPSNoiseEvent& Noise : NoiseEvents)
+			{
+				Crowd->PromoteListeners(Noise.Location, Noise.Loudness, Noise.MaxRange);
+			}
+		}
+
+		RouteNoises(CellSize);
+
+		// Only instigators heard within the interval still need their record
+		const float NoiseInterval = CVarPerceptionNoiseInterval.GetValueOnGameThread();
+		for (auto It = LastNoises.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().IsValid() || FMath::Max(It.Value().Local.Time, It.Value().Remote.Time) + NoiseInterval < Now)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	DeliverHeardNoises();
+
+	FPS_SET_COUNTER(STAT_FPSVisibilityRejections, NumVisibilityRejections);
+}
+
+void UFPSPerceptionSubsystem::RouteNoises(float CellSize)
+{
+	ListenerX.Reset();
+	ListenerY.Reset();
+	ListenerZ.Reset();
+	ListenerObservers.Reset();
+	ListenerNextInCell.Reset();
+	ListenerCellHeads.Reset();
+
+	// Farthest any listener hears a noise of loudness 1, bounds the cells a noise is routed to
+	float MaxHearingRange = 0.0f;
+
+	for (int32 i = 0; i < Observers.Num(); i++)
+	{
+		const FFPSPerceptionObserver& Observer = Observers[i];
+		const UPawnSensingComponent* Sensing = Observer.Sensing.Get();
+		if (Sensing == nullptr || !Observer.bHearNoises)
+		{
+			continue;
+		}
+
+		const FVector Location = Sensing->GetOwner()->GetActorLocation();
+
+		int32& Head = ListenerCellHeads.FindOrAdd(GetCell(Location.X, Location.Y, CellSize), INDEX_NONE);
+		ListenerNextInCell.Add(Head);
+		Head = ListenerObservers.Num();
+
+		ListenerX.Add(Location.X);
+		ListenerY.Add(Location.Y);
+		ListenerZ.Add(Location.Z);
+		ListenerObservers.Add(i);
+
+		MaxHearingRange = FMath::Max3(MaxHearingRange, Sensing->HearingThreshold, Sensing->LOSHearingThreshold);
+	}
+
+	UWorld* World = GetWorld();
+	const AFPSVisibilityGrid* Grid = VisibilityGrid.Get();
+
+	for (const FFPSNoiseEvent& Noise : NoiseEvents)
+	{
+		APawn* Instigator = Noise.Instigator.Get();
+		if (Instigator == nullptr)
+		{
+			continue;
+		}
+
+		float Reach = MaxHearingRange * Noise.Loudness;
+		if (Noise.MaxRange > 0.0f)
+		{
+			Reach = FMath::Min(Reach, Noise.MaxRange);
+		}
+
+		const FIntPoint MinCell = GetCell(Noise.Location.X - Reach, Noise.Location.Y - Reach, CellSize);
+		const FIntPoint MaxCell = GetCell(Noise.Location.X + Reach, Noise.Location.Y + Reach, CellSize);
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++)
+		{
+			for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++)
+			{
+				const int32* Head = ListenerCellHeads.Find(FIntPoint(CellX, CellY));
+				for (int32 Index = Head ? *Head : INDEX_NONE; Index != INDEX_NONE; Index = ListenerNextInCell[Index])
+				{
+					UPawnSensingComponent* Sensing = Observers[ListenerObservers[Index]].Sensing.Get();
+					if (Sensing->GetOwner() == Instigator || (Sensing->bOnlySensePlayers && !Instigator->IsPlayerControlled()))
+					{
+						continue;
+					}
+
+					// Same thresholds as UPawnSensingComponent, close noises are always heard and farther ones only in the open
+					const float DistSq = FVector::DistSquared(Noise.Location, FVector(ListenerX[Index], ListenerY[Index], ListenerZ[Index]));
+					if (Noise.MaxRange > 0.0f && DistSq > FMath::Square(Noise.MaxRange))
+					{
+						continue;
+					}
+
+					const bool bHeard = DistSq <= FMath::Square(Sensing->HearingThreshold * Noise.Loudness);
+					if (!bHeard && DistSq > FMath::Square(Sensing->LOSHearingThreshold * Noise.Loudness))
+					{
+						continue;
+					}
+
+					FFPSHeardNoise HeardNoise;
+					HeardNoise.Sensing = Sensing;
+					HeardNoise.Instigator = Instigator;
+					HeardNoise.Location = Noise.Location;
+					HeardNoise.Loudness = Noise.Loudness;
+
+					if (bHeard)
+					{
+						HeardNoises.Add(HeardNoise);
+						continue;
+					}
+
+					// Never in the open from here, no need to trace
+					if (Grid && !Grid->CanSee(Sensing->GetSensorLocation(), Noise.Location))
+					{
+						NumVisibilityRejections++;
+						continue;
+					}
+
+					FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSHearing), true, Sensing->GetOwner());
+					QueryParams.AddIgnoredActor(Instigator);
+
+					HeardNoise.TraceHandle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Sensing->GetSensorLocation(), Noise.Location, ECC_Visibility, QueryParams);
+					HearingQueries.Add(HeardNoise);
+				}
+			}
+		}
+	}
+
+	NoiseEvents.Reset();
+}
+
+void UFPSPerceptionSubsystem::ResolveHearingQueries()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 i = HearingQueries.Num() - 1; i >= 0; i--)
+	{
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(HearingQueries[i].TraceHandle, Datum))
+		{
+			// Still running, unless the result was dropped, in which case the noise is lost
+			if (!World->IsTraceHandleValid(HearingQueries[i].TraceHandle, false))
+			{
+				HearingQueries.RemoveAtSwap(i, 1, false);
+			}
+			continue;
+		}
+
+		if (!Datum.OutHits.ContainsByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; }))
+		{
+			HeardNoises.Add(HearingQueries[i]);
+		}
+
+		HearingQueries.RemoveAtSwap(i, 1, false);
+	}
+}
+
+void UFPSPerceptionSubsystem::DeliverHeardNoises()
+{
+	// Listeners may make noises of their own when they hear one, those are queued for next frame
+	for (int32 i = 0; i < HeardNoises.Num(); i++)
+	{
+		UPawnSensingComponent* Sensing = HeardNoises[i].Sensing.Get();
+		APawn* Instigator = HeardNoises[i].Instigator.Get();
+		if (Sensing && Instigator)
+		{
+			Sensing->OnHearNoise.Broadcast(Instigator, HeardNoises[i].Location, HeardNoises[i].Loudness);
+		}
+	}
+
+	HeardNoises.Reset();
+}
+
+void UFPSPerceptionSubsystem::ResolveQueries()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 i = Queries.Num() - 1; i >= 0; i--)
+	{
+		const FFPSSightQuery& Query = Queries[i];
+
+		FTraceDatum Datum;
+		if (!World->QueryTraceData(Query.TraceHandle, Datum))
+		{
+			// Still running, unless the result was dropped, in which case the pawn is looked for again next update
+			if (!World->IsTraceHandleValid(Query.TraceHandle, false))
+			{
+				Queries.RemoveAtSwap(i, 1, false);
+			}
+			continue;
+		}
+
+		UPawnSensingComponent* Sensing = Query.Sensing.Get();
+		APawn* Pawn = Query.Pawn.Get();
+
+		// Both ends are ignored by the trace, anything blocking is in the way
+		const bool bBlocked = Datum.OutHits.ContainsByPredicate([](const FHitResult& Result) { return Result.bBlockingHit; });
+
+		Queries.RemoveAtSwap(i, 1, false);
+
+		if (Sensing && Pawn && !bBlocked)
+		{
+			Sensing->OnSeePawn.Broadcast(Pawn);
+		}
+	}
+}
+
+FIntPoint UFPSPerceptionSubsystem::GetCell(float X, float Y, float CellSize)
+{
+	return FIntPoint(FMath::FloorToInt(X / CellSize), FMath::FloorToInt(Y / CellSize));
+}
+
+void UFPSPerceptionSubsystem::BuildGrid(float CellSize)
+{
+	Targets.Reset();
+	CellHeads.Reset();
+
+	for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+	{
+		APawn* Pawn = *It;
+		if (Pawn->IsHidden())
+		{
+			continue;
+		}
+
+		const FVector Location = Pawn->GetActorLocation();
+
+		// Push the pawn at the front of its cell's list
+		int32& Head = CellHeads.FindOrAdd(GetCell(Location.X, Location.Y, CellSize), INDEX_NONE);
+		Targets.NextInCell.Add(Head);
+		Head = Targets.Num();
+
+		Targets.X.Add(Location.X);
+		Targets.Y.Add(Location.Y);
+		Targets.Z.Add(Location.Z);
+		Targets.Pawns.Add(Pawn);
+	}
+}
+
+void UFPSPerceptionSubsystem::SenseFrom(UPawnSensingComponent* Sensing, float CellSize)
+{
+	const AActor* Owner = Sensing->GetOwner();
+	const FVector Eye = Sensing->GetSensorLocation();
+	const float SightRadius = Sensing->SightRadius;
+
+	CandidateIndices.Reset();
+	CandidateX.Reset();
+	CandidateY.Reset();
+	CandidateZ.Reset();
+
+	const FIntPoint MinCell = GetCell(Eye.X - SightRadius, Eye.Y - SightRadius, CellSize);
+	const FIntPoint MaxCell = GetCell(Eye.X + SightRadius, Eye.Y + SightRadius, CellSize);
+	for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++)
+	{
+		for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++)
+		{
+			const int32* Head = CellHeads.Find(FIntPoint(CellX, CellY));
+			for (int32 Index = Head ? *Head : INDEX_NONE; Index != INDEX_NONE; Index = Targets.NextInCell[Index])
+			{
+				const APawn* Pawn = Targets.Pawns[Index];
+				if (Pawn == Owner || (Sensing->bOnlySensePlayers && !Pawn->IsPlayerControlled()))
+				{
+					continue;
+				}
+
+				CandidateIndices.Add(Index);
+				CandidateX.Add(Targets.X[Index]);
+				CandidateY.Add(Targets.Y[Index]);
+				CandidateZ.Add(Targets.Z[Index]);
+			}
+		}
+	}
+
+	if (CandidateIndices.Num() == 0)
+	{
+		return;
+	}
+
+	CullCandidates(Eye, Sensing->GetSensorRotation().Vector(), FMath::Square(SightRadius), Sensing->GetPeripheralVisionCosine());
+
+	UWorld* World = GetWorld();
+	const AFPSVisibilityGrid* Grid = VisibilityGrid.Get();
+	for (int32 i = 0; i < CandidateIndices.Num(); i++)
+	{
+		if (!CandidateVisible[i])
+		{
+			continue;
+		}
+
+		APawn* Pawn = Targets.Pawns[CandidateIndices[i]];
+
+		// Cells that can never see each other, no need to trace
+		if (Grid && !Grid->CanSee(Eye, Pawn->GetActorLocation()))
+		{
+			NumVisibilityRejections++;
+			continue;
+		}
+
+		// Same line of sight as AController::LineOfSightTo, from the eyes to the pawn with both of them ignored
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSSight), true, Owner);
+		QueryParams.AddIgnoredActor(Pawn);
+
+		FFPSSightQuery& Query = Queries.AddDefaulted_GetRef();
+		Query.Sensing = Sensing;
+		Query.Pawn = Pawn;
+		Query.TraceHandle = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Eye, Pawn->GetActorLocation(), ECC_Visibility, QueryParams);
+	}
+}
+
+void UFPSPerceptionSubsystem::CullCandidates(const FVector& Eye, const FVector& Forward, float RadiusSq, float PeripheralVisionCosine)
+{
+	const int32 NumCandidates = CandidateIndices.Num();
+	CandidateVisible.SetNumUninitialized(NumCandidates, false);
+
+	const float* RESTRICT CandX = CandidateX.GetData();
+	const float* RESTRICT CandY = CandidateY.GetData();
+	const float* RESTRICT CandZ = CandidateZ.GetData();
+	uint8* RESTRICT Visible = CandidateVisible.GetData();
+
+	// cos(angle) >= Cos compared squared with the signs kept, so there is no square root and no branch in the loop
+	const float SignedCosSq = PeripheralVisionCosine * FMath::Abs(PeripheralVisionCosine);
+
+	for (int32 i = 0; i < NumCandidates; i++)
+	{
+		const float DX = CandX[i] - Eye.X;
+		const float DY = CandY[i] - Eye.Y;
+		const float DZ = CandZ[i] - Eye.Z;
+
+		const float DistSq = DX * DX + DY * DY + DZ * DZ;
+		const float Dot = DX * Forward.X + DY * Forward.Y + DZ * Forward.Z;
+
+		const uint8 bInRange = DistSq <= RadiusSq;
+		const uint8 bInCone = Dot * FMath::Abs(Dot) >= SignedCosSq * DistSq;
+		Visible[i] = bInRange & bInCone;
+	}
+}
+
+ETickableTickType UFPSPerceptionSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSPerceptionSubsystem::IsTickable() const
+{
+	return Observers.Num() > 0 || Queries.Num() > 0 || NoiseEvents.Num() > 0 || HearingQueries.Num() > 0;
+}
+
+TStatId UFPSPerceptionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSPerceptionSubsystem, STATGROUP_Tickables);
+}
@@ -1,12 +1,36 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "FPSProjectile.h"
+#include "FPSGame.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSCharacter.h"
+#include "Net/UnrealNetwork.h"
+#include "GameFramework/GameStateBase.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Tick"), STAT_FPSProjectileTick, STATGROUP_FPSGame);
+
+// The saving over ReplicatedMovement is an estimate from the property layouts (about 20 bytes once per launch or bounce against
+// about 20 bytes every net update), it hasn't been measured with a network profile
+static TAutoConsoleVariable<int32> CVarProjectileReplicateLaunchOnly(
+	TEXT("fps.Projectile.ReplicateLaunchOnly"),
+	1,
+	TEXT("When 1 projectiles replicate their launch once and clients simulate the flight, when 0 movement is replicated every update."),
+	ECVF_Default);
+
+// Clients fast-forward a late launch in steps of this size so bounces along the way are still swept
+static const float LaunchCatchUpStep = 1.0f / 60.0f;
 
 AFPSProjectile::AFPSProjectile() 
 {
+	// Only ticks while blending out a prediction correction
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
 	// Use a sphere as a simple collision representation
 	CollisionComp = CreateDefaultSubobject<USphereComponent>(TEXT("SphereComp"));
 	CollisionComp->InitSphereRadius(5.0f);
@@ -27,6 +51,7 @@ AFPSProjectile::AFPSProjectile()
 	ProjectileMovement->MaxSpeed = 1500.0f;
 	ProjectileMovement->bRotationFollowsVelocity = true;
 	ProjectileMovement->bShouldBounce = true;
+	ProjectileMovement->OnProjectileBounce.AddDynamic(this, &AFPSProjectile::OnBounce);
 
 	ProjectileMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ProjectileMesh"));
 	ProjectileMesh->SetupAttachment(RootComponent);
@@ -36,6 +61,175 @@ AFPSProjectile::AFPSProjectile()
 
 	SetReplicates(true);
 	SetReplicateMovement(true);
+
+	MaxLaunchCatchUpTime = 0.5f;
+
+	PredictionId = 0;
+	PredictionBlendTime = 0.0f;
+	PredictionBlendTimeLeft = 0.0f;
+}
+
+void AFPSProjectile::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (HasAuthority())
+	{
+		UpdateLaunchState();
+	}
+}
+
+void AFPSProjectile::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSProjectileTick);
+
+	Super::Tick(DeltaTime);
+
+	PredictionBlendTimeLeft -= DeltaTime;
+	if (PredictionBlendTimeLeft <= 0.0f)
+	{
+		ProjectileMesh->SetRelativeLocation(MeshRelativeLocation);
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	const float Alpha = PredictionBlendTimeLeft / PredictionBlendTime;
+	ProjectileMesh->SetWorldLocation(GetActorTransform().TransformPosition(MeshRelativeLocation) + PredictionOffset * Alpha);
+}
+
+void AFPSProjectile::SetPredictionId(uint8 NewPredictionId)
+{
+	PredictionId = NewPredictionId;
+}
+
+void AFPSProjectile::BlendFromPredictedLocation(const FVector& PredictedLocation, float BlendTime)
+{
+	if (BlendTime <= 0.0f)
+	{
+		return;
+	}
+
+	if (!IsActorTickEnabled())
+	{
+		MeshRelativeLocation = ProjectileMesh->GetRelativeLocation();
+	}
+
+	PredictionOffset = PredictedLocation - GetActorLocation();
+	PredictionBlendTime = BlendTime;
+	PredictionBlendTimeLeft = BlendTime;
+
+	ProjectileMesh->SetWorldLocation(GetActorTransform().TransformPosition(MeshRelativeLocation) + PredictionOffset);
+	SetActorTickEnabled(true);
+}
+
+void AFPSProjectile::OnRep_PredictionId()
+{
+	if (PredictionId == 0)
+	{
+		return;
+	}
+
+	// Only the thrower has a proxy to reconcile
+	AFPSCharacter* Thrower = Cast<AFPSCharacter>(GetInstigator());
+	if (Thrower && Thrower->IsLocallyControlled())
+	{
+		Thrower->ReconcilePredictedThrowable(this);
+	}
+}
+
+void AFPSProjectile::UpdateLaunchState()
+{
+	// Pool callbacks also run for predicted proxies, which have authority on their own client
+	if (!HasAuthority() || GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const bool bLaunchOnly = CVarProjectileReplicateLaunchOnly.GetValueOnGameThread() != 0;
+	SetReplicateMovement(!bLaunchOnly);
+
+	const FVector Velocity = ProjectileMovement->Velocity;
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+
+	LaunchState.Origin = GetActorLocation();
+	LaunchState.Direction = Velocity.GetSafeNormal();
+	LaunchState.Speed = (uint16)FMath::Clamp(FMath::RoundToInt(Velocity.Size()), 0, (int32)MAX_uint16);
+	LaunchState.ServerTime = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	LaunchState.Sequence++;
+}
+
+void AFPSProjectile::OnRep_LaunchState()
+{
+	// Movement replication is on, the transform stream already places us
+	if (IsReplicatingMovement())
+	{
+		return;
+	}
+
+	SetActorLocation(LaunchState.Origin, false, nullptr, ETeleportType::ResetPhysics);
+
+	ProjectileMovement->SetUpdatedComponent(CollisionComp);
+	ProjectileMovement->Velocity = LaunchState.Direction * LaunchState.Speed;
+	ProjectileMovement->UpdateComponentVelocity();
+
+	if (LaunchState.Speed == 0)
+	{
+		return;
+	}
+
+	// Catch up with where the server has it by now, the flight is deterministic from here
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	float CatchUpTime = GameState ? FMath::Clamp(GameState->GetServerWorldTimeSeconds() - LaunchState.ServerTime, 0.0f, MaxLaunchCatchUpTime) : 0.0f;
+	while (CatchUpTime > KINDA_SMALL_NUMBER && ProjectileMovement->UpdatedComponent)
+	{
+		const float Step = FMath::Min(CatchUpTime, LaunchCatchUpStep);
+		ProjectileMovement->TickComponent(Step, LEVELTICK_All, nullptr);
+		CatchUpTime -= Step;
+	}
+}
+
+float AFPSProjectile::GetReplicatedFlightTime() const
+{
+	// The transform stream places us about where the server launched us, only the launch state catches up
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (IsReplicatingMovement() || GameState == nullptr || LaunchState.Speed == 0)
+	{
+		return 0.0f;
+	}
+
+	return FMath::Clamp(GameState->GetServerWorldTimeSeconds() - LaunchState.ServerTime, 0.0f, MaxLaunchCatchUpTime);
+}
+
+void AFPSProjectile::OnBounce(const FHitResult& ImpactResult, const FVector& ImpactVelocity)
+{
+	// Resend from the bounce so clients that hit something slightly different get back on the server path
+	if (HasAuthority() && !IsReplicatingMovement())
+	{
+		UpdateLaunchState();
+	}
+}
+
+void AFPSProjectile::OnAcquiredFromPool()
+{
+	UpdateLaunchState();
+}
+
+void AFPSProjectile::OnMaterialized(float RemainingFuzeTime)
+{
+	// The batched simulation set a new velocity after we were acquired
+	UpdateLaunchState();
+}
+
+void AFPSProjectile::OnReturnedToPool()
+{
+	// Reset so the next throw always triggers OnRep_PredictionId, even if it reuses the same id
+	PredictionId = 0;
+
+	if (IsActorTickEnabled())
+	{
+		ProjectileMesh->SetRelativeLocation(MeshRelativeLocation);
+		SetActorTickEnabled(false);
+	}
 }
 
 
@@ -47,10 +241,33 @@ void AFPSProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPr
 		OtherComp->AddImpulseAtLocation(GetVelocity() * 100.0f, GetActorLocation());
 	}
 
-	if (GetLocalRole() == ROLE_Authority)
+	if (GetLocalRole() != ROLE_Authority)
+	{
+		return;
+	}
+
+	// A thrower's predicted proxy also has authority on its own client, only the server's projectile is heard and replicated
+	if (GetNetMode() != NM_Client)
 	{
 		MakeNoise(1.0f, GetInstigator());
 
-		Destroy();
+		// Let clients stop where the server did, the pool sends it along with the hidden state
+		ProjectileMovement->StopMovementImmediately();
+		UpdateLaunchState();
 	}
+
+	UFPSProjectilePoolSubsystem::ReturnOrDestroy(this);
+}
+
+void AFPSProjectile::LifeSpanExpired()
+{
+	UFPSProjectilePoolSubsystem::ReturnOrDestroy(this);
+}
+
+void AFPSProjectile::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AFPSProjectile, LaunchState);
+	DOREPLIFETIME(AFPSProjectile, PredictionId);
 }
\ No newline at end of file
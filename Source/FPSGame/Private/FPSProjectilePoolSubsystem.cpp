@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSGame.h"
+#include "FPSThrowable.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarProjectilePoolEnabled(
+	TEXT("fps.ProjectilePool.Enabled"),
+	1,
+	TEXT("When 0 throwables are spawned and destroyed as usual instead of being pooled."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarProjectilePoolMaxPerClass(
+	TEXT("fps.ProjectilePool.MaxPerClass"),
+	64,
+	TEXT("Maximum number of parked instances kept per throwable class."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld ProjectilePoolDumpStatsCommand(
+	TEXT("fps.ProjectilePool.DumpStats"),
+	TEXT("Logs the projectile pool hit/miss counters for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		UFPSProjectilePoolSubsystem* Pool = World ? World->GetSubsystem<UFPSProjectilePoolSubsystem>() : nullptr;
+		if (Pool)
+		{
+			const FFPSProjectilePoolStats Stats = Pool->GetStats();
+			UE_LOG(LogFPSPhysics, Log, TEXT("Projectile pool: %d hits, %d misses, %d returns, %d overflows"), Stats.Hits, Stats.Misses, Stats.Returns, Stats.Overflows);
+		}
+	}));
+
+void UFPSProjectilePoolSubsystem::Deinitialize()
+{
+	ParkedActors.Empty();
+	ParkedLookup.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSProjectilePoolSubsystem::Prewarm(TSubclassOf<AActor> Class, int32 Count)
+{
+	if (!Class || !CVarProjectilePoolEnabled.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	const int32 TargetCount = FMath::Min(Count, CVarProjectilePoolMaxPerClass.GetValueOnGameThread());
+	for (int32 i = GetNumParked(Class); i < TargetCount; i++)
+	{
+		AActor* Actor = SpawnPooledActor(Class, FTransform::Identity, nullptr);
+		if (Actor == nullptr)
+		{
+			break;
+		}
+
+		ParkActor(Actor);
+	}
+}
+
+AActor* UFPSProjectilePoolSubsystem::Acquire(TSubclassOf<AActor> Class, const FTransform& SpawnTransform, APawn* InInstigator)
+{
+	if (!Class)
+	{
+		return nullptr;
+	}
+
+	TArray<TWeakObjectPtr<AActor>>* Parked = ParkedActors.Find(Class.Get());
+	while (Parked && Parked->Num() > 0)
+	{
+		TWeakObjectPtr<AActor> Candidate = Parked->Pop(false);
+		ParkedLookup.Remove(Candidate);
+
+		// Parked actors can still be destroyed from the outside (level streaming, black holes...)
+		AActor* Actor = Candidate.Get();
+		if (Actor && !Actor->IsPendingKillPending())
+		{
+			Stats.Hits++;
+
+			WakeActor(Actor, SpawnTransform, InInstigator);
+			return Actor;
+		}
+	}
+
+	Stats.Misses++;
+
+	return SpawnPooledActor(Class, SpawnTransform, InInstigator);
+}
+
+bool UFPSProjectilePoolSubsystem::Release(AActor* Actor)
+{
+	if (Actor == nullptr || !CVarProjectilePoolEnabled.GetValueOnGameThread())
+	{
+		return false;
+	}
+
+	if (!Actor->HasAuthority() || !Actor->Implements<UFPSThrowable>() || Actor->GetWorld() != GetWorld())
+	{
+		return false;
+	}
+
+	if (ParkedLookup.Contains(Actor))
+	{
+		return true;
+	}
+
+	TArray<TWeakObjectPtr<AActor>>& Parked = ParkedActors.FindOrAdd(Actor->GetClass());
+	if (Parked.Num() >= CVarProjectilePoolMaxPerClass.GetValueOnGameThread())
+	{
+		Stats.Overflows++;
+		return false;
+	}
+
+	Stats.Returns++;
+
+	ParkActor(Actor);
+	return true;
+}
+
+int32 UFPSProjectilePoolSubsystem::GetNumParked(TSubclassOf<AActor> Class) const
+{
+	const TArray<TWeakObjectPtr<AActor>>* Parked = ParkedActors.Find(Class.Get());
+	return Parked ? Parked->Num() : 0;
+}
+
+void UFPSProjectilePoolSubsystem::ReturnOrDestroy(AActor* Actor)
+{
+	if (Actor == nullptr || Actor->IsPendingKillPending())
+	{
+		return;
+	}
+
+	UWorld* World = Actor->GetWorld();
+	UFPSProjectilePoolSubsystem* Pool = World ? World->GetSubsystem<UFPSProjectilePoolSubsystem>() : nullptr;
+	if (Pool && Pool->Release(Actor))
+	{
+		return;
+	}
+
+	Actor->Destroy();
+}
+
+AActor* UFPSProjectilePoolSubsystem::SpawnPooledActor(TSubclassOf<AActor> Class, const FTransform& SpawnTransform, APawn* InInstigator)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		return nullptr;
+	}
+
+	//Set Spawn Collision Handling Override
+	FActorSpawnParameters ActorSpawnParams;
+	ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	ActorSpawnParams.Instigator = InInstigator;
+
+	return World->SpawnActor<AActor>(Class, SpawnTransform, ActorSpawnParams);
+}
+
+void UFPSProjectilePoolSubsystem::WakeActor(AActor* Actor, const FTransform& SpawnTransform, APawn* InInstigator)
+{
+	Actor->SetNetDormancy(DORM_Awake);
+
+	Actor->SetInstigator(InInstigator);
+	Actor->SetActorLocationAndRotation(SpawnTransform.GetLocation(), SpawnTransform.GetRotation(), false, nullptr, ETeleportType::ResetPhysics);
+
+	Actor->SetActorHiddenInGame(false);
+	Actor->SetActorEnableCollision(true);
+	Actor->SetActorTickEnabled(Actor->PrimaryActorTick.bStartWithTickEnabled);
+
+	// Same launch velocity the movement component computes in InitializeComponent for a fresh spawn
+	UProjectileMovementComponent* Movement = Actor->FindComponentByClass<UProjectileMovementComponent>();
+	if (Movement)
+	{
+		Movement->SetUpdatedComponent(Actor->GetRootComponent());
+		Movement->Velocity = SpawnTransform.GetRotation().Vector() * Movement->InitialSpeed;
+		Movement->UpdateComponentVelocity();
+		Movement->Activate(true);
+		Movement->SetComponentTickEnabled(true);
+	}
+
+	Actor->SetLifeSpan(Actor->InitialLifeSpan);
+
+	IFPSThrowable* Throwable = Cast<IFPSThrowable>(Actor);
+	if (Throwable)
+	{
+		Throwable->OnAcquiredFromPool();
+	}
+
+	Actor->ForceNetUpdate();
+}
+
+void UFPSProjectilePoolSubsystem::ParkActor(AActor* Actor)
+{
+	IFPSThrowable* Throwable = Cast<IFPSThrowable>(Actor);
+	if (Throwable)
+	{
+		Throwable->OnReturnedToPool();
+	}
+
+	// Clears the fuze and lifespan timers as well
+	Actor->GetWorldTimerManager().ClearAllTimersForObject(Actor);
+	Actor->SetLifeSpan(0.0f);
+
+	UProjectileMovementComponent* Movement = Actor->FindComponentByClass<UProjectileMovementComponent>();
+	if (Movement)
+	{
+		Movement->StopMovementImmediately();
+		Movement->SetComponentTickEnabled(false);
+	}
+
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actor->SetActorTickEnabled(false);
+
+	// Send the hidden state once, then stop considering the actor for replication until it is handed out again
+	Actor->ForceNetUpdate();
+	Actor->SetNetDormancy(DORM_DormantAll);
+
+	ParkedActors.FindOrAdd(Actor->GetClass()).Add(Actor);
+	ParkedLookup.Add(Actor);
+}
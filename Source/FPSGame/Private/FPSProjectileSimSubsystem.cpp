@@ -0,0 +1,550 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSProjectileSimSubsystem.h"
+#include "FPSGame.h"
+#include "FPSProjectilePoolSubsystem.h"
+#include "FPSProjectile.h"
+#include "FPSThrowable.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "GameFramework/Pawn.h"
+#include "Components/SphereComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Sim Tick"), STAT_FPSProjectileSimTick, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Live Projectiles"), STAT_FPSLiveProjectiles, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<int32> CVarProjectileSimEnabled(
+	TEXT("fps.ProjectileSim.Enabled"),
+	0,
+	TEXT("When 1 thrown projectiles are flown by the batched projectile simulation until they hit something."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarProjectileSimMaxProjectiles(
+	TEXT("fps.ProjectileSim.MaxProjectiles"),
+	4096,
+	TEXT("Maximum number of projectiles simulated in batch at once, further throws spawn actors."),
+	ECVF_Default);
+
+int32 FFPSSimulatedProjectiles::Add(const FVector& Position, const FVector& Velocity, float InGravityZ, float MaxSpeed, float FuzeTime, float LifeSpan, int32 ClassIndex, APawn* Instigator, uint8 PredictionId, bool bCosmeticOnly)
+{
+	Positions.Add(Position);
+	PreviousPositions.Add(Position);
+	Velocities.Add(Velocity);
+	GravityZ.Add(InGravityZ);
+	MaxSpeeds.Add(MaxSpeed);
+	FuzeTimes.Add(FuzeTime);
+	LifeSpans.Add(LifeSpan);
+	BounceCounts.Add(0);
+	AtRest.Add(0);
+	ClassIndices.Add(ClassIndex);
+	SweepHandles.Add(FTraceHandle());
+	PredictionIds.Add(PredictionId);
+	CosmeticOnly.Add(bCosmeticOnly ? 1 : 0);
+	return Instigators.Add(Instigator);
+}
+
+void FFPSSimulatedProjectiles::RemoveAtSwap(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	PreviousPositions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	GravityZ.RemoveAtSwap(Index, 1, false);
+	MaxSpeeds.RemoveAtSwap(Index, 1, false);
+	FuzeTimes.RemoveAtSwap(Index, 1, false);
+	LifeSpans.RemoveAtSwap(Index, 1, false);
+	BounceCounts.RemoveAtSwap(Index, 1, false);
+	AtRest.RemoveAtSwap(Index, 1, false);
+	ClassIndices.RemoveAtSwap(Index, 1, false);
+	SweepHandles.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+	PredictionIds.RemoveAtSwap(Index, 1, false);
+	CosmeticOnly.RemoveAtSwap(Index, 1, false);
+}
+
+void FFPSSimulatedProjectiles::Reset()
+{
+	Positions.Reset();
+	PreviousPositions.Reset();
+	Velocities.Reset();
+	GravityZ.Reset();
+	MaxSpeeds.Reset();
+	FuzeTimes.Reset();
+	LifeSpans.Reset();
+	BounceCounts.Reset();
+	AtRest.Reset();
+	ClassIndices.Reset();
+	SweepHandles.Reset();
+	Instigators.Reset();
+	PredictionIds.Reset();
+	CosmeticOnly.Reset();
+}
+
+void UFPSProjectileSimSubsystem::Deinitialize()
+{
+	if (CosmeticsActor.IsValid())
+	{
+		CosmeticsActor->Destroy();
+	}
+
+	Projectiles.Reset();
+	ClassInfos.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UFPSProjectileSimSubsystem::Launch(TSubclassOf<AActor> Class, const FVector& Location, const FRotator& Rotation, APawn* InInstigator, uint8 PredictionId)
+{
+	UWorld* World = GetWorld();
+	if (!Class || World == nullptr || !CVarProjectileSimEnabled.GetValueOnGameThread())
+	{
+		return false;
+	}
+
+	if (Projectiles.Num() >= CVarProjectileSimMaxProjectiles.GetValueOnGameThread())
+	{
+		return false;
+	}
+
+	const int32 ClassIndex = FindOrAddClassInfo(Class);
+	if (ClassIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FFPSSimulatedClassInfo& Info = ClassInfos[ClassIndex];
+	const FVector Velocity = Rotation.Vector() * Info.InitialSpeed;
+
+	Projectiles.Add(Location, Velocity, World->GetGravityZ() * Info.GravityScale, Info.MaxSpeed, Info.FuzeTime, Info.LifeSpan, ClassIndex, InInstigator, PredictionId, false);
+	return true;
+}
+
+void UFPSProjectileSimSubsystem::LaunchCosmetic(TSubclassOf<AActor> Class, const FVector& Location, const FRotator& Rotation, APawn* InInstigator, float ElapsedTime)
+{
+	// The server already decided to simulate it, so the cvar isn't checked here
+	UWorld* World = GetWorld();
+	if (!Class || World == nullptr || Projectiles.Num() >= CVarProjectileSimMaxProjectiles.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	const int32 ClassIndex = FindOrAddClassInfo(Class);
+	if (ClassIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FFPSSimulatedClassInfo& Info = ClassInfos[ClassIndex];
+	const float GravityZ = World->GetGravityZ() * Info.GravityScale;
+
+	// Catch up on the flight so far without sweeping it, capped so a late RPC doesn't start it through a wall
+	const float CatchUpTime = FMath::Clamp(ElapsedTime, 0.0f, 0.25f);
+	const FVector LaunchVelocity = Rotation.Vector() * Info.InitialSpeed;
+	const FVector Position = Location + LaunchVelocity * CatchUpTime + FVector(0.0f, 0.0f, 0.5f * GravityZ * CatchUpTime * CatchUpTime);
+	const FVector Velocity = LaunchVelocity + FVector(0.0f, 0.0f, GravityZ * CatchUpTime);
+
+	const float FuzeTime = Info.FuzeTime > 0.0f ? FMath::Max(Info.FuzeTime - CatchUpTime, KINDA_SMALL_NUMBER) : 0.0f;
+	const float LifeSpan = Info.LifeSpan > 0.0f ? FMath::Max(Info.LifeSpan - CatchUpTime, KINDA_SMALL_NUMBER) : 0.0f;
+
+	Projectiles.Add(Position, Velocity, GravityZ, Info.MaxSpeed, FuzeTime, LifeSpan, ClassIndex, InInstigator, 0, true);
+}
+
+int32 UFPSProjectileSimSubsystem::FindOrAddClassInfo(UClass* Class)
+{
+	for (int32 i = 0; i < ClassInfos.Num(); i++)
+	{
+		if (ClassInfos[i].Class == Class)
+		{
+			return i;
+		}
+	}
+
+	const AActor* DefaultActor = Class->GetDefaultObject<AActor>();
+	const UProjectileMovementComponent* Movement = DefaultActor ? DefaultActor->FindComponentByClass<UProjectileMovementComponent>() : nullptr;
+	const UPrimitiveComponent* Root = DefaultActor ? Cast<UPrimitiveComponent>(DefaultActor->GetRootComponent()) : nullptr;
+	if (Movement == nullptr || Root == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	FFPSSimulatedClassInfo Info;
+	Info.Class = Class;
+	Info.InitialSpeed = Movement->InitialSpeed;
+	Info.MaxSpeed = Movement->MaxSpeed;
+	Info.GravityScale = Movement->ProjectileGravityScale;
+	Info.Bounciness = Movement->Bounciness;
+	Info.Friction = Movement->Friction;
+	Info.StopSimulatingThreshold = Movement->BounceVelocityStopSimulatingThreshold;
+	Info.bShouldBounce = Movement->bShouldBounce;
+	Info.LifeSpan = DefaultActor->InitialLifeSpan;
+
+	const USphereComponent* Sphere = Cast<USphereComponent>(Root);
+	if (Sphere)
+	{
+		Info.Radius = Sphere->GetUnscaledSphereRadius();
+	}
+
+	Info.CollisionChannel = Root->GetCollisionObjectType();
+	Info.ResponseParams.CollisionResponse = Root->GetCollisionResponseToChannels();
+
+	const IFPSThrowable* Throwable = Cast<IFPSThrowable>(DefaultActor);
+	if (Throwable)
+	{
+		Info.FuzeTime = Throwable->GetFuzeTime();
+		Info.bMaterializeOnAnyHit = Throwable->MaterializeOnAnyHit();
+		Info.bMakesNoiseOnHit = Throwable->MakesNoiseOnHit();
+	}
+
+	// Cosmetics only matter where something renders
+	UWorld* World = GetWorld();
+	const UStaticMeshComponent* MeshComp = DefaultActor->FindComponentByClass<UStaticMeshComponent>();
+	if (MeshComp && MeshComp->GetStaticMesh() && World->GetNetMode() != NM_DedicatedServer)
+	{
+		if (!CosmeticsActor.IsValid())
+		{
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.ObjectFlags |= RF_Transient;
+			CosmeticsActor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		}
+
+		if (CosmeticsActor.IsValid())
+		{
+			UInstancedStaticMeshComponent* Instances = NewObject<UInstancedStaticMeshComponent>(CosmeticsActor.Get());
+			Instances->SetStaticMesh(MeshComp->GetStaticMesh());
+			Instances->SetMobility(EComponentMobility::Movable);
+			Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			Instances->RegisterComponent();
+
+			Info.Cosmetics = Instances;
+			Info.MeshRelativeTransform = MeshComp->GetRelativeTransform();
+		}
+	}
+
+	return ClassInfos.Add(Info);
+}
+
+void UFPSProjectileSimSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSProjectileSimTick);
+	FPS_SET_COUNTER(STAT_FPSLiveProjectiles, Projectiles.Num());
+
+	PendingRemovals.Reset();
+
+	ResolveSweeps();
+
+	// Fuzes and lifespans
+	for (int32 i = 0; i < Projectiles.Num(); i++)
+	{
+		if (Projectiles.FuzeTimes[i] > 0.0f)
+		{
+			Projectiles.FuzeTimes[i] -= DeltaTime;
+			if (Projectiles.FuzeTimes[i] <= 0.0f)
+			{
+				AddRemoval(i, true);
+				continue;
+			}
+		}
+
+		if (Projectiles.LifeSpans[i] > 0.0f)
+		{
+			Projectiles.LifeSpans[i] -= DeltaTime;
+			if (Projectiles.LifeSpans[i] <= 0.0f)
+			{
+				AddRemoval(i, false);
+			}
+		}
+	}
+
+	// Highest index first so RemoveAtSwap never moves an entry that is still pending
+	PendingRemovals.Sort([](const FPendingRemoval& A, const FPendingRemoval& B) { return A.Index > B.Index; });
+	for (const FPendingRemoval& Removal : PendingRemovals)
+	{
+		if (Removal.bMaterialize && !Projectiles.CosmeticOnly[Removal.Index])
+		{
+			Materialize(Removal.Index);
+		}
+
+		Projectiles.RemoveAtSwap(Removal.Index);
+	}
+
+	Integrate(DeltaTime);
+
+	IssueSweeps();
+
+	UpdateCosmetics();
+}
+
+void UFPSProjectileSimSubsystem::AddRemoval(int32 Index, bool bMaterialize)
+{
+	for (FPendingRemoval& Removal : PendingRemovals)
+	{
+		if (Removal.Index == Index)
+		{
+			Removal.bMaterialize |= bMaterialize;
+			return;
+		}
+	}
+
+	PendingRemovals.Add({ Index, bMaterialize });
+}
+
+void UFPSProjectileSimSubsystem::ResolveSweeps()
+{
+	UWorld* World = GetWorld();
+
+	FTraceDatum Datum;
+	for (int32 i = 0; i < Projectiles.Num(); i++)
+	{
+		FTraceHandle& Handle = Projectiles.SweepHandles[i];
+		if (!Handle.IsValid())
+		{
+			continue;
+		}
+
+		if (!World->QueryTraceData(Handle, Datum))
+		{
+			// Keep waiting unless the result is gone for good
+			if (!World->IsTraceHandleValid(Handle, false))
+			{
+				Handle = FTraceHandle();
+			}
+			continue;
+		}
+
+		Handle = FTraceHandle();
+
+		const FHitResult* Hit = FHitResult::GetFirstBlockingHit(Datum.OutHits);
+		if (Hit == nullptr)
+		{
+			continue;
+		}
+
+		const FFPSSimulatedClassInfo& Info = ClassInfos[Projectiles.ClassIndices[i]];
+
+		// Pawns and physics bodies need the actor's OnHit, hand off just before the impact
+		const UPrimitiveComponent* HitComp = Hit->GetComponent();
+		const bool bNeedsActor = Info.bMaterializeOnAnyHit || !Info.bShouldBounce || Cast<APawn>(Hit->GetActor()) || (HitComp && HitComp->IsSimulatingPhysics());
+		if (bNeedsActor)
+		{
+			Projectiles.Positions[i] = Hit->Location - Projectiles.Velocities[i].GetSafeNormal();
+			AddRemoval(i, true);
+			continue;
+		}
+
+		// Same bounce response as UProjectileMovementComponent::ComputeBounceDelta
+		FVector Velocity = Projectiles.Velocities[i];
+		const float VDotNormal = FVector::DotProduct(Velocity, Hit->Normal);
+		if (VDotNormal < 0.0f)
+		{
+			const FVector ProjectedNormal = Hit->Normal * -VDotNormal;
+			Velocity += ProjectedNormal;
+			Velocity *= FMath::Clamp(1.0f - Info.Friction, 0.0f, 1.0f);
+			Velocity += ProjectedNormal * FMath::Max(Info.Bounciness, 0.0f);
+		}
+
+		Projectiles.Positions[i] = Hit->Location + Hit->Normal * 0.1f;
+		Projectiles.BounceCounts[i] = FMath::Min<int32>(Projectiles.BounceCounts[i] + 1, MAX_uint8);
+
+		if (Velocity.SizeSquared() < FMath::Square(Info.StopSimulatingThreshold))
+		{
+			Velocity = FVector::ZeroVector;
+			Projectiles.AtRest[i] = 1;
+		}
+
+		Projectiles.Velocities[i] = Velocity;
+
+		// Bouncing throwables that are heard from their actor OnHit are heard on every bounce
+		APawn* Instigator = Projectiles.Instigators[i].Get();
+		if (Info.bMakesNoiseOnHit && Instigator && !Projectiles.CosmeticOnly[i])
+		{
+			Instigator->MakeNoise(1.0f, Instigator, Hit->Location);
+		}
+	}
+}
+
+void UFPSProjectileSimSubsystem::Integrate(float DeltaTime)
+{
+	const int32 Num = Projectiles.Num();
+	FVector* RESTRICT Positions = Projectiles.Positions.GetData();
+	FVector* RESTRICT PreviousPositions = Projectiles.PreviousPositions.GetData();
+	FVector* RESTRICT Velocities = Projectiles.Velocities.GetData();
+	const float* RESTRICT GravityZ = Projectiles.GravityZ.GetData();
+	const uint8* RESTRICT AtRest = Projectiles.AtRest.GetData();
+	const FTraceHandle* RESTRICT SweepHandles = Projectiles.SweepHandles.GetData();
+
+	const VectorRegister DeltaTimeV = VectorSetFloat1(DeltaTime);
+	const VectorRegister HalfDeltaTimeSqV = VectorSetFloat1(0.5f * DeltaTime * DeltaTime);
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		PreviousPositions[i] = Positions[i];
+
+		// Resting projectiles don't move, and ones still waiting on their sweep stay put until it resolves
+		if (AtRest[i] || SweepHandles[i].IsValid())
+		{
+			continue;
+		}
+
+		// p += v * dt + a * dt^2 / 2, v += a * dt, same step as UProjectileMovementComponent::ComputeMoveDelta
+		const VectorRegister Accel = MakeVectorRegister(0.0f, 0.0f, GravityZ[i], 0.0f);
+		const VectorRegister Velocity = VectorLoadFloat3(&Velocities[i]);
+		VectorRegister Position = VectorLoadFloat3(&Positions[i]);
+		Position = VectorMultiplyAdd(Velocity, DeltaTimeV, Position);
+		Position = VectorMultiplyAdd(Accel, HalfDeltaTimeSqV, Position);
+
+		VectorStoreFloat3(Position, &Positions[i]);
+		VectorStoreFloat3(VectorMultiplyAdd(Accel, DeltaTimeV, Velocity), &Velocities[i]);
+	}
+
+	const float* RESTRICT MaxSpeeds = Projectiles.MaxSpeeds.GetData();
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (MaxSpeeds[i] > 0.0f && Velocities[i].SizeSquared() > FMath::Square(MaxSpeeds[i]))
+		{
+			Velocities[i] = Velocities[i].GetClampedToMaxSize(MaxSpeeds[i]);
+		}
+	}
+}
+
+void UFPSProjectileSimSubsystem::IssueSweeps()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 i = 0; i < Projectiles.Num(); i++)
+	{
+		if (Projectiles.AtRest[i] || Projectiles.SweepHandles[i].IsValid())
+		{
+			continue;
+		}
+
+		const FFPSSimulatedClassInfo& Info = ClassInfos[Projectiles.ClassIndices[i]];
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSProjectileSim), false, Projectiles.Instigators[i].Get());
+
+		Projectiles.SweepHandles[i] = World->AsyncSweepByChannel(EAsyncTraceType::Single,
+			Projectiles.PreviousPositions[i],
+			Projectiles.Positions[i],
+			FQuat::Identity,
+			Info.CollisionChannel,
+			FCollisionShape::MakeSphere(Info.Radius),
+			QueryParams,
+			Info.ResponseParams);
+	}
+}
+
+void UFPSProjectileSimSubsystem::Materialize(int32 Index)
+{
+	UWorld* World = GetWorld();
+	UFPSProjectilePoolSubsystem* Pool = World->GetSubsystem<UFPSProjectilePoolSubsystem>();
+
+	const FFPSSimulatedClassInfo& Info = ClassInfos[Projectiles.ClassIndices[Index]];
+	UClass* Class = Info.Class.Get();
+	if (Pool == nullptr || Class == nullptr)
+	{
+		return;
+	}
+
+	const FVector Velocity = Projectiles.Velocities[Index];
+	const FRotator Rotation = Velocity.IsNearlyZero() ? FRotator::ZeroRotator : Velocity.Rotation();
+
+	AActor* Actor = Pool->Acquire(Class, FTransform(Rotation, Projectiles.Positions[Index]), Projectiles.Instigators[Index].Get());
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	// The pool starts the full InitialLifeSpan, keep counting down from where the simulation was
+	if (Info.LifeSpan > 0.0f)
+	{
+		Actor->SetLifeSpan(FMath::Max(Projectiles.LifeSpans[Index], KINDA_SMALL_NUMBER));
+	}
+
+	// Continue with the simulated velocity rather than the launch speed
+	UProjectileMovementComponent* Movement = Actor->FindComponentByClass<UProjectileMovementComponent>();
+	if (Movement)
+	{
+		Movement->Velocity = Velocity;
+		Movement->UpdateComponentVelocity();
+	}
+
+	IFPSThrowable* Throwable = Cast<IFPSThrowable>(Actor);
+	if (Throwable)
+	{
+		Throwable->OnMaterialized(Info.FuzeTime > 0.0f ? Projectiles.FuzeTimes[Index] : 0.0f);
+	}
+
+	// The thrower's proxy has been waiting for this projectile since the launch
+	AFPSProjectile* Projectile = Cast<AFPSProjectile>(Actor);
+	if (Projectile && Projectiles.PredictionIds[Index] != 0)
+	{
+		Projectile->SetPredictionId(Projectiles.PredictionIds[Index]);
+	}
+}
+
+void UFPSProjectileSimSubsystem::UpdateCosmetics()
+{
+	if (!CosmeticsActor.IsValid())
+	{
+		return;
+	}
+
+	CosmeticInstanceCounts.Reset();
+	CosmeticInstanceCounts.AddZeroed(ClassInfos.Num());
+
+	for (int32 i = 0; i < Projectiles.Num(); i++)
+	{
+		const int32 ClassIndex = Projectiles.ClassIndices[i];
+		const FFPSSimulatedClassInfo& Info = ClassInfos[ClassIndex];
+
+		UInstancedStaticMeshComponent* Instances = Info.Cosmetics.Get();
+		if (Instances == nullptr)
+		{
+			continue;
+		}
+
+		const FVector& Velocity = Projectiles.Velocities[i];
+		const FTransform InstanceTransform = Info.MeshRelativeTransform * FTransform(Velocity.IsNearlyZero() ? FRotator::ZeroRotator : Velocity.Rotation(), Projectiles.Positions[i]);
+
+		const int32 InstanceIndex = CosmeticInstanceCounts[ClassIndex]++;
+		if (InstanceIndex < Instances->GetInstanceCount())
+		{
+			Instances->UpdateInstanceTransform(InstanceIndex, InstanceTransform, true, false, true);
+		}
+		else
+		{
+			Instances->AddInstanceWorldSpace(InstanceTransform);
+		}
+	}
+
+	for (int32 ClassIndex = 0; ClassIndex < ClassInfos.Num(); ClassIndex++)
+	{
+		UInstancedStaticMeshComponent* Instances = ClassInfos[ClassIndex].Cosmetics.Get();
+		if (Instances)
+		{
+			while (Instances->GetInstanceCount() > CosmeticInstanceCounts[ClassIndex])
+			{
+				Instances->RemoveInstance(Instances->GetInstanceCount() - 1);
+			}
+
+			Instances->MarkRenderStateDirty();
+		}
+	}
+}
+
+ETickableTickType UFPSProjectileSimSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSProjectileSimSubsystem::IsTickable() const
+{
+	return Projectiles.Num() > 0;
+}
+
+TStatId UFPSProjectileSimSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSProjectileSimSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSReplicationGraph.h"
+#include "FPSGame.h"
+#include "FPSCharacter.h"
+#include "FPSAIGuard.h"
+#include "FPSObjective.h"
+#include "FPSThrowable.h"
+#include "UObject/UObjectIterator.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net Actors Considered"), STAT_FPSNetActorsConsidered, STATGROUP_FPSGame);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Net Actors Dormant"), STAT_FPSNetActorsDormant, STATGROUP_FPSGame);
+
+UFPSReplicationGraph::UFPSReplicationGraph()
+{
+	GridCellSize = 5000.0f;
+	CharacterCullDistance = 15000.0f;
+	ThrowableCullDistance = 5000.0f;
+	GuardCullDistance = 15000.0f;
+	GuardNetUpdateFrequency = 10.0f;
+}
+
+bool UFPSReplicationGraph::IsDynamic(const UClass* Class)
+{
+	return Class->IsChildOf(AFPSCharacter::StaticClass()) || Class->ImplementsInterface(UFPSThrowable::StaticClass());
+}
+
+bool UFPSReplicationGraph::IsAlwaysRelevant(const UClass* Class)
+{
+	return Class->IsChildOf(AFPSObjective::StaticClass());
+}
+
+void UFPSReplicationGraph::InitGlobalActorClassSettings()
+{
+	// Every replicated class gets its cull distance and frequency from its defaults, ours are overridden below
+	Super::InitGlobalActorClassSettings();
+
+	FClassReplicationInfo CharacterInfo;
+	CharacterInfo.SetCullDistanceSquared(FMath::Square(CharacterCullDistance));
+	CharacterInfo.ReplicationPeriodFrame = 1;
+
+	FClassReplicationInfo ThrowableInfo;
+	ThrowableInfo.SetCullDistanceSquared(FMath::Square(ThrowableCullDistance));
+	ThrowableInfo.ReplicationPeriodFrame = 1;
+
+	FClassReplicationInfo GuardInfo;
+	GuardInfo.SetCullDistanceSquared(FMath::Square(GuardCullDistance));
+	GuardInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(GuardNetUpdateFrequency);
+
+	// Native classes and the blueprints already loaded, blueprints loaded later inherit the entry of their closest parent
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		if (!Class->IsChildOf(AActor::StaticClass()))
+		{
+			continue;
+		}
+
+		if (Class->IsChildOf(AFPSAIGuard::StaticClass()))
+		{
+			GlobalActorReplicationInfoMap.SetClassInfo(Class, GuardInfo);
+		}
+		else if (Class->IsChildOf(AFPSCharacter::StaticClass()))
+		{
+			GlobalActorReplicationInfoMap.SetClassInfo(Class, CharacterInfo);
+		}
+		else if (Class->ImplementsInterface(UFPSThrowable::StaticClass()))
+		{
+			GlobalActorReplicationInfoMap.SetClassInfo(Class, ThrowableInfo);
+		}
+	}
+}
+
+void UFPSReplicationGraph::InitGlobalGraphNodes()
+{
+	Super::InitGlobalGraphNodes();
+
+	GridNode->CellSize = GridCellSize;
+}
+
+void UFPSReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	const UClass* Class = ActorInfo.Class;
+
+	if (IsAlwaysRelevant(Class))
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (IsDynamic(Class))
+	{
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+	}
+	else
+	{
+		// Game state and player states (always relevant), owner-only actors, and the dormancy aware grid for the rest, guards included
+		Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalInfo);
+	}
+}
+
+void UFPSReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	const UClass* Class = ActorInfo.Class;
+
+	if (IsAlwaysRelevant(Class))
+	{
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else if (IsDynamic(Class))
+	{
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+	}
+	else
+	{
+		Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+	}
+}
+
+int32 UFPSReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+#if STATS || CSV_PROFILER
+	// Every actor routed to the graph, placed ones still in their initial dormancy included. Dormant ones are left out of the
+	// lists the grid gathers for each connection, the rest are considered every frame they are due
+	int32 NumActors = 0;
+	int32 NumDormant = 0;
+	for (auto It = GlobalActorReplicationInfoMap.CreateActorMapIterator(); It; ++It)
+	{
+		NumActors++;
+		NumDormant += It.Value()->bWantsToBeDormant ? 1 : 0;
+	}
+
+	FPS_SET_COUNTER(STAT_FPSNetActorsConsidered, NumActors - NumDormant);
+	FPS_SET_COUNTER(STAT_FPSNetActorsDormant, NumDormant);
+#endif
+
+	return Super::ServerReplicateActors(DeltaSeconds);
+}
@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSSignificanceSubsystem.h"
+#include "FPSGame.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Significance Tick"), STAT_FPSSignificanceTick, STATGROUP_FPSGame);
+
+static TAutoConsoleVariable<int32> CVarSignificanceEnabled(
+	TEXT("fps.Significance.Enabled"),
+	1,
+	TEXT("When 0 every registered actor is kept at High significance."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarSignificanceMaxUpdatesPerFrame(
+	TEXT("fps.Significance.MaxUpdatesPerFrame"),
+	32,
+	TEXT("Number of registered actors scored per frame, the rest wait for their turn."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceMediumDistance(
+	TEXT("fps.Significance.MediumDistance"),
+	2500.0f,
+	TEXT("Beyond this distance from every player actors drop to Medium significance."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceLowDistance(
+	TEXT("fps.Significance.LowDistance"),
+	6000.0f,
+	TEXT("Beyond this distance from every player actors drop to Low significance."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceDormantDistance(
+	TEXT("fps.Significance.DormantDistance"),
+	12000.0f,
+	TEXT("Beyond this distance from every player actors go Dormant."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSignificanceOffscreenScale(
+	TEXT("fps.Significance.OffscreenScale"),
+	2.0f,
+	TEXT("Distance multiplier for actors behind a player's view."),
+	ECVF_Default);
+
+void UFPSSignificanceSubsystem::Deinitialize()
+{
+	Entries.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFPSSignificanceSubsystem::Register(AActor* Actor)
+{
+	if (Actor == nullptr || !Actor->Implements<UFPSSignificant>())
+	{
+		return;
+	}
+
+	const bool bRegistered = Entries.ContainsByPredicate([Actor](const FEntry& Entry) { return Entry.Actor == Actor; });
+	if (!bRegistered)
+	{
+		Entries.Add({ Actor, EFPSSignificance::High });
+	}
+}
+
+void UFPSSignificanceSubsystem::Unregister(AActor* Actor)
+{
+	const int32 Index = Entries.IndexOfByPredicate([Actor](const FEntry& Entry) { return Entry.Actor == Actor; });
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	SetSignificance(Entries[Index], EFPSSignificance::High);
+
+	Entries.RemoveAtSwap(Index, 1, false);
+}
+
+EFPSSignificance UFPSSignificanceSubsystem::GetSignificance(const AActor* Actor) const
+{
+	const FEntry* Entry = Entries.FindByPredicate([Actor](const FEntry& Entry) { return Entry.Actor == Actor; });
+	return Entry ? Entry->Significance : EFPSSignificance::High;
+}
+
+void UFPSSignificanceSubsystem::Tick(float DeltaTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSSignificanceTick);
+
+	const bool bEnabled = CVarSignificanceEnabled.GetValueOnGameThread() != 0;
+	if (bEnabled)
+	{
+		GatherViews();
+	}
+
+	const int32 NumUpdates = FMath::Min(Entries.Num(), FMath::Max(1, CVarSignificanceMaxUpdatesPerFrame.GetValueOnGameThread()));
+	for (int32 i = 0; i < NumUpdates && Entries.Num() > 0; i++)
+	{
+		if (NextEntry >= Entries.Num())
+		{
+			NextEntry = 0;
+		}
+
+		FEntry& Entry = Entries[NextEntry];
+		AActor* Actor = Entry.Actor.Get();
+		if (Actor == nullptr)
+		{
+			// Destroyed without unregistering, the swapped in entry gets this slot's turn
+			Entries.RemoveAtSwap(NextEntry, 1, false);
+			continue;
+		}
+
+		SetSignificance(Entry, bEnabled ? Evaluate(Actor->GetActorLocation()) : EFPSSignificance::High);
+		NextEntry++;
+	}
+}
+
+void UFPSSignificanceSubsystem::GatherViews()
+{
+	ViewLocations.Reset();
+	ViewDirections.Reset();
+
+	// All players on the server, the local ones on a client
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (PC == nullptr || PC->GetPawn() == nullptr)
+		{
+			continue;
+		}
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		ViewLocations.Add(ViewLocation);
+		ViewDirections.Add(ViewRotation.Vector());
+	}
+}
+
+EFPSSignificance UFPSSignificanceSubsystem::Evaluate(const FVector& Location) const
+{
+	const float OffscreenScale = CVarSignificanceOffscreenScale.GetValueOnGameThread();
+
+	float BestDistSq = MAX_flt;
+	for (int32 i = 0; i < ViewLocations.Num(); i++)
+	{
+		const FVector Delta = Location - ViewLocations[i];
+		float DistSq = Delta.SizeSquared();
+
+		// Behind the player counts as further away
+		if ((Delta | ViewDirections[i]) < 0.0f)
+		{
+			DistSq *= FMath::Square(OffscreenScale);
+		}
+
+		BestDistSq = FMath::Min(BestDistSq, DistSq);
+	}
+
+	if (BestDistSq > FMath::Square(CVarSignificanceDormantDistance.GetValueOnGameThread()))
+	{
+		return EFPSSignificance::Dormant;
+	}
+	if (BestDistSq > FMath::Square(CVarSignificanceLowDistance.GetValueOnGameThread()))
+	{
+		return EFPSSignificance::Low;
+	}
+	if (BestDistSq > FMath::Square(CVarSignificanceMediumDistance.GetValueOnGameThread()))
+	{
+		return EFPSSignificance::Medium;
+	}
+	return EFPSSignificance::High;
+}
+
+void UFPSSignificanceSubsystem::SetSignificance(FEntry& Entry, EFPSSignificance NewSignificance)
+{
+	if (Entry.Significance == NewSignificance)
+	{
+		return;
+	}
+
+	Entry.Significance = NewSignificance;
+
+	IFPSSignificant* Significant = Cast<IFPSSignificant>(Entry.Actor.Get());
+	if (Significant)
+	{
+		Significant->OnSignificanceChanged(NewSignificance);
+	}
+}
+
+ETickableTickType UFPSSignificanceSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UFPSSignificanceSubsystem::IsTickable() const
+{
+	return Entries.Num() > 0;
+}
+
+TStatId UFPSSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFPSSignificanceSubsystem, STATGROUP_Tickables);
+}
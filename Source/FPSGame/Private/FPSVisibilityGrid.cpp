@@ -0,0 +1,275 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSVisibilityGrid.h"
+#include "FPSGame.h"
+#include "FPSPerceptionSubsystem.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+
+AFPSVisibilityGrid::AFPSVisibilityGrid()
+{
+	BoundsComp = CreateDefaultSubobject<UBoxComponent>(TEXT("BoundsComp"));
+	BoundsComp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	BoundsComp->SetBoxExtent(FVector(5000.0f, 5000.0f, 500.0f));
+	RootComponent = BoundsComp;
+
+	CellSize = 1000.0f;
+	MaxDistance = 6000.0f;
+	SamplesPerAxis = 5;
+
+	BakedOrigin = FVector::ZeroVector;
+	BakedDims = FIntVector::ZeroValue;
+	BakedCellSize = 0.0f;
+	BakedSamplesPerAxis = 0;
+}
+
+void AFPSVisibilityGrid::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Only the server senses
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	// Baking takes far too long for a level load, without an up to date bake the perception subsystem has no grid and traces
+	// every pair like before
+	if (!IsUpToDate())
+	{
+		UE_LOG(LogFPSAI, Warning, TEXT("%s was not baked for its current bounds or settings, every pair counts as visible. Use Build Visibility in the editor"), *GetName());
+		return;
+	}
+
+	UFPSPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UFPSPerceptionSubsystem>();
+	if (Perception)
+	{
+		Perception->SetVisibilityGrid(this);
+	}
+}
+
+void AFPSVisibilityGrid::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UFPSPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UFPSPerceptionSubsystem>();
+	if (Perception)
+	{
+		Perception->SetVisibilityGrid(nullptr);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool AFPSVisibilityGrid::IsUpToDate() const
+{
+	const FVector Extent = BoundsComp->GetScaledBoxExtent();
+	const FIntVector Dims(
+		FMath::CeilToInt(2.0f * Extent.X / CellSize),
+		FMath::CeilToInt(2.0f * Extent.Y / CellSize),
+		FMath::CeilToInt(2.0f * Extent.Z / CellSize));
+
+	const int32 NumCells = BakedDims.X * BakedDims.Y * BakedDims.Z;
+
+	return NumCells > 0
+		&& BakedDims == Dims
+		&& BakedCellSize == CellSize
+		&& BakedSamplesPerAxis == SamplesPerAxis
+		&& BakedOrigin.Equals(GetActorLocation() - Extent)
+		&& VisibilityBits.Num() == FMath::DivideAndRoundUp<int64>(GetPairIndex(NumCells - 1, NumCells - 1, NumCells) + 1, 32);
+}
+
+int32 AFPSVisibilityGrid::GetCellIndex(const FVector& Location) const
+{
+	const FVector Local = (Location - BakedOrigin) / BakedCellSize;
+	const int32 X = FMath::FloorToInt(Local.X);
+	const int32 Y = FMath::FloorToInt(Local.Y);
+	const int32 Z = FMath::FloorToInt(Local.Z);
+
+	if (X < 0 || Y < 0 || Z < 0 || X >= BakedDims.X || Y >= BakedDims.Y || Z >= BakedDims.Z)
+	{
+		return INDEX_NONE;
+	}
+
+	return (Z * BakedDims.Y + Y) * BakedDims.X + X;
+}
+
+int64 AFPSVisibilityGrid::GetPairIndex(int32 CellA, int32 CellB, int32 NumCells)
+{
+	// Row A of the upper triangle holds the pairs (A, A) to (A, NumCells - 1)
+	const int64 A = FMath::Min(CellA, CellB);
+	const int64 B = FMath::Max(CellA, CellB);
+	return A * NumCells - (A * (A - 1)) / 2 + (B - A);
+}
+
+bool AFPSVisibilityGrid::CanSee(const FVector& From, const FVector& To) const
+{
+	const int32 FromCell = GetCellIndex(From);
+	const int32 ToCell = GetCellIndex(To);
+	if (FromCell == INDEX_NONE || ToCell == INDEX_NONE || VisibilityBits.Num() == 0)
+	{
+		return true;
+	}
+
+	const int64 Bit = GetPairIndex(FromCell, ToCell, BakedDims.X * BakedDims.Y * BakedDims.Z);
+	return (VisibilityBits[Bit >> 5] & (1u << (Bit & 31))) != 0;
+}
+
+bool AFPSVisibilityGrid::TraceCells(const FIntVector& CellA, const FIntVector& CellB, const TArray<FVector>& SampleOffsets) const
+{
+	const FVector CenterA = BakedOrigin + (FVector(CellA) + 0.5f) * BakedCellSize;
+	const FVector CenterB = BakedOrigin + (FVector(CellB) + 0.5f) * BakedCellSize;
+
+	// Only the blockout counts, anything that moves or opens never hides a pair
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(FPSVisibilityBake), false, this);
+
+	// A single clear line is enough, the pair is only hidden when all of them are blocked
+	for (const FVector& OffsetA : SampleOffsets)
+	{
+		for (const FVector& OffsetB : SampleOffsets)
+		{
+			if (!GetWorld()->LineTraceTestByObjectType(CenterA + OffsetA * BakedCellSize, CenterB + OffsetB * BakedCellSize, ObjectParams, QueryParams))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void AFPSVisibilityGrid::BuildVisibility()
+{
+	const FVector Extent = BoundsComp->GetScaledBoxExtent();
+
+	BakedCellSize = FMath::Max(100.0f, CellSize);
+	CellSize = BakedCellSize;
+	BakedSamplesPerAxis = FMath::Clamp(SamplesPerAxis, 2, 8);
+	SamplesPerAxis = BakedSamplesPerAxis;
+	BakedOrigin = GetActorLocation() - Extent;
+	BakedDims = FIntVector(
+		FMath::CeilToInt(2.0f * Extent.X / BakedCellSize),
+		FMath::CeilToInt(2.0f * Extent.Y / BakedCellSize),
+		FMath::CeilToInt(2.0f * Extent.Z / BakedCellSize));
+
+	const int32 NumCells = BakedDims.X * BakedDims.Y * BakedDims.Z;
+
+	VisibilityBits.Reset();
+	if (NumCells <= 0)
+	{
+		return;
+	}
+
+	const int64 NumPairs = GetPairIndex(NumCells - 1, NumCells - 1, NumCells) + 1;
+	VisibilityBits.SetNumZeroed((int32)FMath::DivideAndRoundUp<int64>(NumPairs, 32));
+
+	// Pairs further apart than this always count as visible, the cell diagonal keeps every point in range covered
+	const float MaxCenterDistSq = FMath::Square(MaxDistance + BakedCellSize * FMath::Sqrt(3.0f));
+
+	// Evenly spread over the whole cell, faces and corners included, so lines through any opening wider than the spacing are tried
+	TArray<FVector> SampleOffsets;
+	SampleOffsets.Reserve(BakedSamplesPerAxis * BakedSamplesPerAxis * BakedSamplesPerAxis);
+	for (int32 Z = 0; Z < BakedSamplesPerAxis; Z++)
+	{
+		for (int32 Y = 0; Y < BakedSamplesPerAxis; Y++)
+		{
+			for (int32 X = 0; X < BakedSamplesPerAxis; X++)
+			{
+				SampleOffsets.Add(FVector((float)X, (float)Y, (float)Z) / (float)(BakedSamplesPerAxis - 1) - 0.5f);
+			}
+		}
+	}
+
+	int32 NumTraced = 0;
+	for (int32 A = 0; A < NumCells; A++)
+	{
+		const FIntVector CellA(A % BakedDims.X, (A / BakedDims.X) % BakedDims.Y, A / (BakedDims.X * BakedDims.Y));
+
+		for (int32 B = A; B < NumCells; B++)
+		{
+			const FIntVector CellB(B % BakedDims.X, (B / BakedDims.X) % BakedDims.Y, B / (BakedDims.X * BakedDims.Y));
+
+			// Neighbours touch, edges and corners included, something in one can always be seen from the other
+			const FIntVector Delta = CellA - CellB;
+			const bool bAdjacent = FMath::Abs(Delta.X) <= 1 && FMath::Abs(Delta.Y) <= 1 && FMath::Abs(Delta.Z) <= 1;
+
+			bool bVisible = true;
+			if (!bAdjacent && FVector(Delta).SizeSquared() * FMath::Square(BakedCellSize) <= MaxCenterDistSq)
+			{
+				bVisible = TraceCells(CellA, CellB, SampleOffsets);
+				NumTraced++;
+			}
+
+			if (bVisible)
+			{
+				const int64 Bit = GetPairIndex(A, B, NumCells);
+				VisibilityBits[Bit >> 5] |= (1u << (Bit & 31));
+			}
+		}
+	}
+
+	// A pair stays hidden only if no pair of their neighbours was found visible either, so a line the samples of one cell missed
+	// but the samples of the next cell caught still counts
+	const TArray<uint32> TracedBits = VisibilityBits;
+	auto IsTracedVisible = [&TracedBits, NumCells](int32 CellA, int32 CellB)
+	{
+		const int64 Bit = GetPairIndex(CellA, CellB, NumCells);
+		return (TracedBits[Bit >> 5] & (1u << (Bit & 31))) != 0;
+	};
+
+	int32 NumHidden = 0;
+	for (int32 A = 0; A < NumCells; A++)
+	{
+		const FIntVector CellA(A % BakedDims.X, (A / BakedDims.X) % BakedDims.Y, A / (BakedDims.X * BakedDims.Y));
+
+		for (int32 B = A + 1; B < NumCells; B++)
+		{
+			if (IsTracedVisible(A, B))
+			{
+				continue;
+			}
+
+			const FIntVector CellB(B % BakedDims.X, (B / BakedDims.X) % BakedDims.Y, B / (BakedDims.X * BakedDims.Y));
+
+			bool bVisible = false;
+			for (int32 NeighbourA = 0; NeighbourA < 27 && !bVisible; NeighbourA++)
+			{
+				const FIntVector NA = CellA + FIntVector(NeighbourA % 3 - 1, (NeighbourA / 3) % 3 - 1, NeighbourA / 9 - 1);
+				if (NA.X < 0 || NA.Y < 0 || NA.Z < 0 || NA.X >= BakedDims.X || NA.Y >= BakedDims.Y || NA.Z >= BakedDims.Z)
+				{
+					continue;
+				}
+
+				for (int32 NeighbourB = 0; NeighbourB < 27 && !bVisible; NeighbourB++)
+				{
+					const FIntVector NB = CellB + FIntVector(NeighbourB % 3 - 1, (NeighbourB / 3) % 3 - 1, NeighbourB / 9 - 1);
+					if (NB.X < 0 || NB.Y < 0 || NB.Z < 0 || NB.X >= BakedDims.X || NB.Y >= BakedDims.Y || NB.Z >= BakedDims.Z)
+					{
+						continue;
+					}
+
+					bVisible = IsTracedVisible((NA.Z * BakedDims.Y + NA.Y) * BakedDims.X + NA.X, (NB.Z * BakedDims.Y + NB.Y) * BakedDims.X + NB.X);
+				}
+			}
+
+			if (bVisible)
+			{
+				const int64 Bit = GetPairIndex(A, B, NumCells);
+				VisibilityBits[Bit >> 5] |= (1u << (Bit & 31));
+			}
+			else
+			{
+				NumHidden++;
+			}
+		}
+	}
+
+	UE_LOG(LogFPSAI, Log, TEXT("%s baked %d cells, %d of %d traced pairs can never see each other (%d KB)"),
+		*GetName(), NumCells, NumHidden, NumTraced, VisibilityBits.Num() * 4 / 1024);
+
+	// Saved with the level when baked in the editor
+	if (!GetWorld()->IsGameWorld())
+	{
+		MarkPackageDirty();
+	}
+}
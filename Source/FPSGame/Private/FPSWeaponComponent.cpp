@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSWeaponComponent.h"
+#include "FPSGame.h"
+#include "FPSWeaponData.h"
+#include "FPSCharacter.h"
+#include "FPSHitscanSubsystem.h"
+#include "FPSLagCompensationSubsystem.h"
+#include "Animation/AnimInstance.h"
+#include "Camera/CameraComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/GameStateBase.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Weapon TickComponent"), STAT_FPSWeaponTick, STATGROUP_FPSGame);
+DECLARE_CYCLE_STAT(TEXT("Weapon Fire"), STAT_FPSWeaponFire, STATGROUP_FPSGame);
+DECLARE_CYCLE_STAT(TEXT("Weapon ServerFire"), STAT_FPSWeaponServerFire, STATGROUP_FPSGame);
+
+// How far the trace start sent by a client may be from where the server has the shooter's view
+static const float MaxFireStartError = 200.0f;
+
+// How far in degrees the aim sent by a client may be from the server's view rotation, which lags behind the client's a little
+static const float MaxFireAimError = 15.0f;
+
+// How early a ServerFire may arrive against the fire rate, covers shots bunched up by network jitter
+static const float FireRateTolerance = 0.05f;
+
+UFPSWeaponComponent::UFPSWeaponComponent()
+{
+	// Only ticks while shots are pending
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	SetIsReplicatedByDefault(true);
+
+	ShotsLeft = 0;
+	NextShotTime = 0.0f;
+	ServerNextShotTime = 0.0f;
+
+	FallbackFireSound = nullptr;
+	FallbackFireAnimation = nullptr;
+}
+
+const UFPSWeaponData* UFPSWeaponComponent::GetWeaponData() const
+{
+	return WeaponData ? WeaponData : GetDefault<UFPSWeaponData>();
+}
+
+void UFPSWeaponComponent::SetFallbackFireEffects(USoundBase* InFireSound, UAnimSequenceBase* InFireAnimation)
+{
+	FallbackFireSound = InFireSound;
+	FallbackFireAnimation = InFireAnimation;
+}
+
+APawn* UFPSWeaponComponent::GetShooter() const
+{
+	AActor* Owner = GetOwner();
+	APawn* Shooter = Cast<APawn>(Owner);
+	if (Shooter == nullptr && Owner)
+	{
+		Shooter = Cast<APawn>(Owner->GetOwner());
+	}
+	return Shooter;
+}
+
+void UFPSWeaponComponent::StartFire()
+{
+	// A new press doesn't restart a burst or hold that is still firing
+	if (ShotsLeft > 0)
+	{
+		return;
+	}
+
+	const UFPSWeaponData* Data = GetWeaponData();
+	switch (Data->FireMode)
+	{
+	case EFPSFireMode::Burst:
+		ShotsLeft = Data->BurstCount;
+		break;
+	case EFPSFireMode::Automatic:
+		ShotsLeft = MAX_int32;
+		break;
+	default:
+		ShotsLeft = 1;
+		break;
+	}
+
+	// Don't let the time spent idle turn into a burst of catch-up shots
+	NextShotTime = FMath::Max(NextShotTime, GetWorld()->GetTimeSeconds());
+
+	FireDueShots();
+}
+
+void UFPSWeaponComponent::StopFire()
+{
+	// Bursts and single shots still waiting on the fire rate finish on their own
+	if (GetWeaponData()->FireMode == EFPSFireMode::Automatic)
+	{
+		ShotsLeft = 0;
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UFPSWeaponComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSWeaponTick);
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	FireDueShots();
+}
+
+void UFPSWeaponComponent::FireDueShots()
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float FireInterval = 1.0f / FMath::Max(GetWeaponData()->FireRate, 0.1f);
+
+	// Several shots per frame when the fire rate is above the frame rate
+	while (ShotsLeft > 0 && NextShotTime <= Now)
+	{
+		FireShot();
+
+		ShotsLeft--;
+		NextShotTime += FireInterval;
+	}
+
+	SetComponentTickEnabled(ShotsLeft > 0);
+}
+
+void UFPSWeaponComponent::FireShot()
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSWeaponFire);
+
+	APawn* Shooter = GetShooter();
+	if (Shooter == nullptr)
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	AFPSCharacter* Character = Cast<AFPSCharacter>(Shooter);
+	if (Character)
+	{
+		ViewLocation = Character->GetFirstPersonCameraComponent()->GetComponentLocation();
+		ViewRotation = Character->GetFirstPersonCameraComponent()->GetComponentRotation();
+	}
+	else
+	{
+		Shooter->GetActorEyesViewPoint(ViewLocation, ViewRotation);
+	}
+
+	// The server world time as we know it matches what we see of the other players
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const float ClientTime = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+
+	// Where we aim, the server adds the spread
+	ServerFire(ViewLocation, ViewRotation.Vector(), ClientTime);
+
+	PlayFireEffects(Shooter);
+}
+
+void UFPSWeaponComponent::PlayFireEffects(APawn* Shooter)
+{
+	const UFPSWeaponData* Data = GetWeaponData();
+	USoundBase* FireSound = Data->FireSound ? Data->FireSound : FallbackFireSound;
+	UAnimSequenceBase* FireAnimation = Data->FireAnimation ? Data->FireAnimation : FallbackFireAnimation;
+
+	// try and play the sound if specified
+	if (FireSound)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetOwner()->GetActorLocation());
+	}
+
+	// try and play a firing animation if specified
+	AFPSCharacter* Character = Cast<AFPSCharacter>(Shooter);
+	if (FireAnimation && Character)
+	{
+		// Get the animation object for the arms mesh
+		UAnimInstance* AnimInstance = Character->GetMesh1P()->GetAnimInstance();
+		if (AnimInstance)
+		{
+			AnimInstance->PlaySlotAnimationAsDynamicMontage(FireAnimation, "Arms", 0.0f);
+		}
+	}
+}
+
+void UFPSWeaponComponent::ServerFire_Implementation(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal TraceDirection, float ClientTime)
+{
+	FPS_SCOPE_CYCLE_COUNTER(STAT_FPSWeaponServerFire);
+
+	APawn* Shooter = GetShooter();
+	if (Shooter == nullptr)
+	{
+		return;
+	}
+
+	const UFPSWeaponData* Data = GetWeaponData();
+
+	// Same fire rate as the shooter's own schedule, for every fire mode, late shots don't bank time for a faster burst
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (Now < ServerNextShotTime - FireRateTolerance)
+	{
+		FPS_LOG_THROTTLED(LogFPSWeapons, Verbose, 1.0, TEXT("%s fired faster than %.1f shots per second, dropping the shot"), *GetNameSafe(Shooter), Data->FireRate);
+		return;
+	}
+
+	ServerNextShotTime = FMath::Max(ServerNextShotTime, Now - FireRateTolerance) + 1.0f / FMath::Max(Data->FireRate, 0.1f);
+
+	// The client's origin and aim only within a tolerance of the shooter's view as we have it, our own view otherwise
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	Shooter->GetActorEyesViewPoint(ViewLocation, ViewRotation);
+
+	AFPSCharacter* Character = Cast<AFPSCharacter>(Shooter);
+	if (Character)
+	{
+		ViewLocation = Character->GetFirstPersonCameraComponent()->GetComponentLocation();
+	}
+
+	FVector Start = TraceStart;
+	if (FVector::DistSquared(Start, ViewLocation) > FMath::Square(MaxFireStartError))
+	{
+		Start = ViewLocation;
+	}
+
+	FVector Direction = TraceDirection;
+	if ((Direction | ViewRotation.Vector()) < FMath::Cos(FMath::DegreesToRadians(MaxFireAimError)))
+	{
+		FPS_LOG_THROTTLED(LogFPSWeapons, Verbose, 1.0, TEXT("%s aimed more than %.0f degrees off its view, using the server's view"), *GetNameSafe(Shooter), MaxFireAimError);
+		Direction = ViewRotation.Vector();
+	}
+
+	// Spread is rolled here, a client can't send its shots without it
+	if (Data->Spread > 0.0f)
+	{
+		Direction = FMath::VRandCone(Direction, FMath::DegreesToRadians(Data->Spread));
+	}
+
+	// Never further back than the lag compensation keeps, never ahead of now
+	UFPSLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UFPSLagCompensationSubsystem>();
+	const float Timestamp = LagCompensation ? LagCompensation->ClampTimestamp(ClientTime) : Now;
+
+	// Traced with every other shot of this frame and resolved the next one
+	UFPSHitscanSubsystem* Hitscan = GetWorld()->GetSubsystem<UFPSHitscanSubsystem>();
+	if (Hitscan)
+	{
+		AActor* IgnoredActor = (GetOwner() != Shooter) ? GetOwner() : nullptr;
+		Hitscan->QueueShot(Shooter, IgnoredActor, Start, Direction, Data->Range, Timestamp, Data->TraceChannel, Data->Impulse, GetOwner(), Data->NoiseLoudness);
+	}
+}
+
+bool UFPSWeaponComponent::ServerFire_Validate(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal TraceDirection, float ClientTime)
+{
+	// Values no honest client can send, anything merely off is corrected in the implementation
+	return !TraceStart.ContainsNaN() && !TraceDirection.ContainsNaN() && FMath::IsFinite(ClientTime);
+}
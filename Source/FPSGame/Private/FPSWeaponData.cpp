@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSWeaponData.h"
+#include "FPSGame.h"
+
+UFPSWeaponData::UFPSWeaponData()
+{
+	FireMode = EFPSFireMode::Single;
+	FireRate = 10.0f;
+	BurstCount = 3;
+	Range = 1500.0f;
+	Spread = 0.0f;
+	TraceChannel = COLLISION_HITBOX;
+	Impulse = 1000.0f;
+	NoiseLoudness = 1.0f;
+}
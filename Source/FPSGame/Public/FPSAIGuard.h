@@ -4,9 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "AITypes.h"
+#include "Navigation/PathFollowingComponent.h"
+#include "FPSSignificant.h"
 #include "FPSAIGuard.generated.h"
 
 class UPawnSensingComponent;
+class AFPSPatrolRoute;
+struct FFPSGuardThinkInput;
+struct FFPSGuardThinkAction;
 
 UENUM(BlueprintType)
 enum class EAIState : uint8
@@ -17,7 +23,7 @@ enum class EAIState : uint8
 };
 
 UCLASS()
-class FPSGAME_API AFPSAIGuard : public ACharacter
+class FPSGAME_API AFPSAIGuard : public ACharacter, public IFPSSignificant
 {
 	GENERATED_BODY()
 
@@ -29,50 +35,143 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	UPROPERTY(VisibleAnywhere, Category = "Components")
 	UPawnSensingComponent* PawnSensingComp;
 
+	/* Sensing interval set up on the component, used at High significance */
+	float DefaultSensingInterval;
+
+	/** Sensing intervals at Medium and Low significance, when no player is near */
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float MediumSignificanceInterval;
+
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float LowSignificanceInterval;
+
 	FRotator OriginalRotation;
 
-	FTimerHandle TimerHandle_ResetOrientation;
+	/* How long a noise keeps us suspicious before we go back to what we were doing */
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float SuspicionDuration;
+
+	/* World time we stop being suspicious */
+	float SuspiciousUntil;
+
+	/* Sensed since we last thought, see UFPSGuardThinkSubsystem */
+	TWeakObjectPtr<APawn> PendingSeenPawn;
+
+	bool bPendingNoise;
+
+	FVector PendingNoiseLocation;
 
 	UPROPERTY(ReplicatedUsing = OnRep_GuardState)
 	EAIState GuardState;
 
-	/* Patrol points to patrol between */
-	//UPROPERTY(EditInstanceOnly, Category = "AI", meta = (EditCondition="bPatrol"))
-	TArray<AActor*> PatrolPoints;
-	AActor* CurrentPatrolPoint;
-	int PatrolPointNumber;
+	/* Hand the guard over to the guard crowd while it is idle and far from every player */
+	UPROPERTY(EditAnywhere, Category = "AI")
+	bool bSimulateInCrowd;
 
 	/* Let the guard go on patrol */
 	UPROPERTY(EditInstanceOnly, Category = "AI")
 	bool bPatrol;
 
+	/* Route to patrol along */
+	UPROPERTY(EditInstanceOnly, Category = "AI", meta = (EditCondition = "bPatrol"))
+	AFPSPatrolRoute* PatrolRoute;
+
+	/* How close to a route point counts as reached */
+	UPROPERTY(EditInstanceOnly, Category = "AI", meta = (EditCondition = "bPatrol"))
+	float PatrolAcceptanceRadius;
+
+	/* Route point we are walking to, INDEX_NONE when not patrolling */
+	int32 PatrolPointIndex;
+
+	/* Move of the controller that walks to PatrolPointIndex */
+	FAIRequestID PatrolMoveRequestId;
+
+	/* Parked hidden while the guard crowd simulates us */
+	bool bInCrowd;
+
+	/** Perception, significance and lag compensation, from BeginPlay to EndPlay except while in the crowd */
+	void RegisterWithSubsystems();
+
+	void UnregisterFromSubsystems();
+
 	UFUNCTION()
 	void OnPawnSeen(APawn* SeenPawn);
 
 	UFUNCTION()
 	void OnNoiseHeard(APawn* NoiseInstigator, const FVector& Location, float Volume);
 
-	UFUNCTION()
-	void ResetOrientation();
+	/** Has us think at the end of the frame about what we sensed */
+	void WakeUp();
 
 	UFUNCTION()
 	void OnRep_GuardState();
 
 	void SetGuardState(EAIState NewState);
 
+	/* Awake while walking a patrol or moved by something else, dormant otherwise */
+	void UpdateNetDormancy();
+
+	/* Checks whether we came to rest since WakeForMovement, runs while we are moved outside a patrol */
+	FTimerHandle MovementSettledTimerHandle;
+
+	void CheckMovementSettled();
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "AI")
 	void OnStateChanged(EAIState NewState);
 
+	/** Heads for the next point of the route along the path baked between the two points */
 	void MoveToNextPatrolPoint();
 
+	/** Walks back to the current point after being interrupted, from wherever we are */
+	void ResumePatrol();
+
+	/** Starts walking the route from PatrolPointIndex, or from its first point */
+	void StartPatrol();
+
+	/** Bound to the AI controller, a patrol move that succeeds sends us on to the next point */
+	UFUNCTION()
+	void OnMoveCompleted(FAIRequestID RequestID, EPathFollowingResult::Type Result);
+
+	virtual void PossessedBy(AController* NewController) override;
+
+	virtual void UnPossessed() override;
+
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	virtual void OnSignificanceChanged(EFPSSignificance NewSignificance) override;
+
+	/** Idle, not investigating anything, and allowed to be simulated by the guard crowd */
+	bool CanJoinCrowd() const;
+
+	/** For guards spawned back from the crowd, before BeginPlay. Patrols Route from PointIndex, or stands still without a route */
+	void SetPatrolStart(AFPSPatrolRoute* Route, int32 PointIndex);
+
+	/** Hides the guard and stops everything it does while the guard crowd simulates it, for guards that can't be respawned */
+	void EnterCrowd();
+
+	/** Brings a parked guard back where the crowd left it, patrolling Route from PointIndex or standing still without a route */
+	void LeaveCrowd(const FVector& Location, const FRotator& Rotation, AFPSPatrolRoute* Route, int32 PointIndex);
+
+	AFPSPatrolRoute* GetPatrolRoute() const { return PatrolRoute; }
+
+	int32 GetPatrolPointIndex() const { return PatrolPointIndex; }
+
+	UPawnSensingComponent* GetPawnSensingComponent() const { return PawnSensingComp; }
+
+	/** Snapshot of what the state machine needs, gathered on the game thread */
+	void GetThinkInput(FFPSGuardThinkInput& OutInput) const;
+
+	/** Applies what the state machine decided, on the game thread */
+	void CommitThink(const FFPSGuardThinkAction& Action);
+
+	/** Keeps replicating while something other than the patrol moves us (impulses, forces, launches), until we come to rest */
+	void WakeForMovement();
 
 	void Die();
 };
\ No newline at end of file
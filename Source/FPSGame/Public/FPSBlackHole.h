@@ -4,12 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "FPSSignificant.h"
 #include "FPSBlackHole.generated.h"
 
 class USphereComponent;
 
 UCLASS()
-class FPSGAME_API AFPSBlackHole : public AActor
+class FPSGAME_API AFPSBlackHole : public AActor, public IFPSSignificant
 {
 	GENERATED_BODY()
 	
@@ -24,9 +25,6 @@ protected:
 	UPROPERTY(VisibleAnywhere, Category = "Components")
 	USphereComponent* InnerSphereComponent;
 
-	UPROPERTY(VisibleAnywhere, Category = "Components")
-	USphereComponent* OuterSphereComponent;
-
 	UPROPERTY(VisibleAnywhere, Category = "BlackHole")
 	float BlackHoleRadius;
 	
@@ -37,11 +35,15 @@ protected:
 	UFUNCTION()
 	void OverlapInnerSphere(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 
+	/* Registered with the force field subsystem while the black hole exists */
+	int32 ForceFieldId;
+
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	virtual void OnSignificanceChanged(EFPSSignificance NewSignificance) override;
 
 };
\ No newline at end of file
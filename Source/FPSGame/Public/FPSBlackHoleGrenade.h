@@ -4,13 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "FPSThrowable.h"
+#include "FPSSignificant.h"
 #include "FPSBlackHoleGrenade.generated.h"
 
 class UProjectileMovementComponent;
 class USphereComponent;
 
 UCLASS()
-class FPSGAME_API AFPSBlackHoleGrenade : public AActor
+class FPSGAME_API AFPSBlackHoleGrenade : public AActor, public IFPSThrowable, public IFPSSignificant
 {
 	GENERATED_BODY()
 	
@@ -26,9 +28,6 @@ protected:
 	UPROPERTY(VisibleAnywhere, Category= "Components")
 	USphereComponent* CollisionComp;
 
-	UPROPERTY(VisibleAnywhere, Category = "Components")
-	USphereComponent* OuterSphereComponent;
-
 	UPROPERTY(EditDefaultsOnly, Category= "Components")
 	UStaticMeshComponent* GrenadeMesh;
 
@@ -55,8 +54,16 @@ protected:
 
 	bool IsExploding;
 
+	/* Collision of the grenade mesh while flying, restored when reused from the pool */
+	TEnumAsByte<ECollisionEnabled::Type> GrenadeMeshCollision;
+
 	FVector Location;
 
+	/* Registered with the force field subsystem while the black hole is active */
+	int32 ForceFieldId;
+
+	void RemoveForceField();
+
 	/* Handle to manage the timer */
 	FTimerHandle FuzeTimerHandle;
 
@@ -70,8 +77,22 @@ protected:
 	UFUNCTION()
  	void EndBlackHole();
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	void StartFuze();
+
+public:
+	virtual void OnAcquiredFromPool() override;
+
+	virtual void OnReturnedToPool() override;
+
+	virtual float GetFuzeTime() const override { return MaxFuzeTime; }
+
+	virtual bool MaterializeOnAnyHit() const override { return false; }
+
+	virtual void OnMaterialized(float RemainingFuzeTime) override;
+
+	virtual void OnSignificanceChanged(EFPSSignificance NewSignificance) override;
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 };
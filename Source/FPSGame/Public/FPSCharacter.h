@@ -11,9 +11,40 @@ class USkeletalMeshComponent;
 class UCameraComponent;
 class USoundBase;
 class UAnimSequence;
+class UAnimSequenceBase;
 class USpringArmComponent;
 class UPawnNoiseEmitterComponent;
 class AFPSProjectile;
+class UFPSWeaponComponent;
+
+USTRUCT(BlueprintType)
+struct FFPSThrowPredictionStats
+{
+	GENERATED_BODY()
+
+	/** Server projectiles that arrived close enough to their proxy to be blended */
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	int32 Matched = 0;
+
+	/** Server projectiles too far from their proxy, snapped instead of blended */
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	int32 Mismatched = 0;
+
+	/** Proxies whose server projectile never arrived */
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	int32 TimedOut = 0;
+
+	/** Proxies that hit something before their server projectile arrived */
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	int32 ProxyFinishedFirst = 0;
+
+	/** Sum and max of the distance between proxy and server projectile, over Matched and Mismatched */
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	float TotalError = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Throwable")
+	float MaxError = 0.0f;
+};
 
 UCLASS()
 class FPSGAME_API AFPSCharacter : public ACharacter
@@ -27,6 +58,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/** Pawn mesh: 1st person view  */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Mesh")
 	USkeletalMeshComponent* Mesh1PComponent;
@@ -42,17 +75,25 @@ protected:
 	/* UPROPERTY(EditDefaultsOnly, Category="Weapon")
 	TSubclassOf<AActor> WeaponClass; */
 
-	/** Sound to play each time we fire */
+	/** Hitscan firing, set up by its weapon data */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Weapon")
+	UFPSWeaponComponent* WeaponComponent;
+
+	/** Sound to play each time we fire, deprecated: only used when the weapon data has no FireSound */
 	UPROPERTY(EditDefaultsOnly, Category="Gameplay")
 	USoundBase* FireSound;
 
-	/** AnimMontage to play each time we fire */
+	/** AnimMontage to play each time we fire, deprecated: only used when the weapon data has no FireAnimation */
 	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
 	UAnimSequenceBase* FireAnimation;
 
 	UPROPERTY(EditDefaultsOnly, Category="Throwable")
 	TSubclassOf<AFPSProjectile> ThrowableClass;
 
+	/** Number of ThrowableClass instances the projectile pool keeps ready on the server */
+	UPROPERTY(EditDefaultsOnly, Category="Throwable")
+	int32 ThrowablePoolSize;
+
 	UPROPERTY(EditDefaultsOnly, Category="Grenade")
 	USoundBase* ThrowSound;
 
@@ -62,13 +103,48 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AI")
 	UPawnNoiseEmitterComponent* NoiseEmitterComponent;
 
+	/** Above this distance a predicted throw is snapped to the server projectile instead of blended */
+	UPROPERTY(EditDefaultsOnly, Category="Throwable")
+	float ThrowPredictionMaxError;
+
+	UPROPERTY(EditDefaultsOnly, Category="Throwable")
+	float ThrowPredictionBlendTime;
+
+	/** How long a proxy waits for its server projectile before it's dropped */
+	UPROPERTY(EditDefaultsOnly, Category="Throwable")
+	float ThrowPredictionTimeout;
+
+	struct FPredictedThrow
+	{
+		uint8 PredictionId;
+		TWeakObjectPtr<AFPSProjectile> Proxy;
+		float SpawnTime;
+	};
+
+	/* Local proxies waiting for their replicated projectile */
+	TArray<FPredictedThrow> PredictedThrows;
+
+	uint8 LastPredictionId;
+
+	FFPSThrowPredictionStats ThrowPredictionStats;
+
+	void GetThrowSpawnLocationAndRotation(FVector& OutLocation, FRotator& OutRotation) const;
+
+	/** Spawns the local proxy for a throw, returns its prediction id or 0 if nothing was predicted */
+	uint8 SpawnPredictedThrowable();
+
+	void ExpirePredictedThrows();
+
 	void Throw();
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerThrow();
-	void ServerThrow_Implementation();
-	bool ServerThrow_Validate();
+	void ServerThrow(uint8 PredictionId);
+	void ServerThrow_Implementation(uint8 PredictionId);
+	bool ServerThrow_Validate(uint8 PredictionId);
 
-	void Fire();
+	/** Throws flown by the server's projectile sim don't replicate until they materialize, clients fly a cosmetic copy */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastSimulatedThrow(TSubclassOf<AActor> Class, FVector_NetQuantize Location, FRotator Rotation, float ServerLaunchTime, uint8 PredictionId);
+	void MulticastSimulatedThrow_Implementation(TSubclassOf<AActor> Class, FVector_NetQuantize Location, FRotator Rotation, float ServerLaunchTime, uint8 PredictionId);
 
 	/** Handles moving forward/backward */
 	void MoveForward(float Val);
@@ -93,4 +169,10 @@ public:
 	void Die();
 
 	virtual void Tick(float DeltaTime) override;
+
+	/** Matches a replicated projectile to the proxy spawned when we threw it */
+	void ReconcilePredictedThrowable(AFPSProjectile* Authoritative);
+
+	UFUNCTION(BlueprintPure, Category = "Throwable")
+	FFPSThrowPredictionStats GetThrowPredictionStats() const { return ThrowPredictionStats; }
 };
\ No newline at end of file
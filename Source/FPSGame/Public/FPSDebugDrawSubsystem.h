@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPSDebugDrawSubsystem.generated.h"
+
+/** Debug drawing only exists in builds that can show it */
+#define FPS_DEBUG_DRAW (!UE_BUILD_SHIPPING && !UE_SERVER)
+
+/** Each one is switched on with its own fps.DebugDraw.* console variable */
+enum class EFPSDebugCategory : uint8
+{
+	Weapons,
+	AI,
+	Explosions
+};
+
+enum class EFPSDebugShape : uint8
+{
+	Line,
+	Box,
+	Sphere
+};
+
+struct FFPSDebugPrimitive
+{
+	EFPSDebugShape Shape = EFPSDebugShape::Line;
+
+	/** Line start, box or sphere center */
+	FVector Location = FVector::ZeroVector;
+
+	/** Line end or box extent */
+	FVector Vector = FVector::ZeroVector;
+
+	float Radius = 0.0f;
+	int32 Segments = 0;
+	FColor Color = FColor::White;
+	float Thickness = 0.0f;
+	float ExpireTime = 0.0f;
+};
+
+/**
+ * Debug primitives of the gameplay code.
+ * They are recorded into a fixed-size ring buffer and drawn from it for a single frame at a time, so a burst of shots or a long
+ * lived sphere never piles up in the line batcher and the oldest primitives are dropped when the buffer is full.
+ * Use the FPS_DEBUG_* macros, they compile to nothing in Shipping and dedicated server builds.
+ *
+ * Primitives are only drawn in the world that records them and are never replicated. Dedicated servers don't create the
+ * subsystem, so what only runs there (hitscan hits, guard perception, explosions) is not drawn on their clients. Debug it
+ * in standalone or from the listen server's host instead.
+ */
+UCLASS()
+class FPSGAME_API UFPSDebugDrawSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Deinitialize() override;
+
+	/** Returns the subsystem of World if Category is enabled, null otherwise */
+	static UFPSDebugDrawSubsystem* Get(const UWorld* World, EFPSDebugCategory Category);
+
+	void AddLine(const FVector& Start, const FVector& End, const FColor& Color, float Duration, float Thickness = 0.0f);
+
+	void AddBox(const FVector& Center, const FVector& Extent, const FColor& Color, float Duration, float Thickness = 0.0f);
+
+	void AddSphere(const FVector& Center, float Radius, int32 Segments, const FColor& Color, float Duration, float Thickness = 0.0f);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	/** Claims the next slot, overwriting the oldest primitive when the buffer is full */
+	FFPSDebugPrimitive& AddPrimitive(EFPSDebugShape Shape, const FColor& Color, float Duration, float Thickness);
+
+	TArray<FFPSDebugPrimitive> Primitives;
+
+	/** Slot the next primitive is written to */
+	int32 Head = 0;
+
+	int32 Num = 0;
+};
+
+#if FPS_DEBUG_DRAW
+#define FPS_DEBUG_LINE(World, Category, Start, End, Color, Duration, Thickness) \
+	do { if (UFPSDebugDrawSubsystem* DebugDraw = UFPSDebugDrawSubsystem::Get(World, Category)) { DebugDraw->AddLine(Start, End, Color, Duration, Thickness); } } while (0)
+#define FPS_DEBUG_BOX(World, Category, Center, Extent, Color, Duration, Thickness) \
+	do { if (UFPSDebugDrawSubsystem* DebugDraw = UFPSDebugDrawSubsystem::Get(World, Category)) { DebugDraw->AddBox(Center, Extent, Color, Duration, Thickness); } } while (0)
+#define FPS_DEBUG_SPHERE(World, Category, Center, Radius, Segments, Color, Duration, Thickness) \
+	do { if (UFPSDebugDrawSubsystem* DebugDraw = UFPSDebugDrawSubsystem::Get(World, Category)) { DebugDraw->AddSphere(Center, Radius, Segments, Color, Duration, Thickness); } } while (0)
+#else
+#define FPS_DEBUG_LINE(World, Category, Start, End, Color, Duration, Thickness)
+#define FPS_DEBUG_BOX(World, Category, Center, Extent, Color, Duration, Thickness)
+#define FPS_DEBUG_SPHERE(World, Category, Center, Radius, Segments, Color, Duration, Thickness)
+#endif
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "Engine/EngineTypes.h"
+#include "FPSExplosionSubsystem.generated.h"
+
+class UPrimitiveComponent;
+class UCharacterMovementComponent;
+
+/** A body caught in an explosion, waiting on its line of sight traces */
+struct FFPSExplosionTarget
+{
+	/** Points traced from the blast center on every body, the share that get through is the body's exposure */
+	static constexpr int32 NumExposureSamples = 3;
+
+	TWeakObjectPtr<AActor> Actor;
+
+	/** Physics body to push, null for characters */
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+
+	/** Character movement to push, null for physics bodies */
+	TWeakObjectPtr<UCharacterMovementComponent> CharacterMovement;
+
+	FTraceHandle Traces[NumExposureSamples];
+};
+
+struct FFPSExplosion
+{
+	TWeakObjectPtr<AActor> Source;
+
+	FVector Center = FVector::ZeroVector;
+	float Radius = 0.0f;
+	float Strength = 0.0f;
+	ERadialImpulseFalloff Falloff = RIF_Constant;
+
+	/** Sphere overlap issued when the explosion was queued */
+	FTraceHandle OverlapHandle;
+
+	/** Filled once the overlap is back, the traces for every target are issued in the same frame */
+	TArray<FFPSExplosionTarget> Targets;
+
+	bool bTracesIssued = false;
+};
+
+/**
+ * Resolves explosion impulses off the game thread.
+ * Explode queues a sphere overlap. The next frame the bodies it found get line of sight traces from the blast center, issued
+ * together for every explosion of that frame, and the frame after the impulse is applied scaled by how exposed each body is.
+ */
+UCLASS()
+class FPSGAME_API UFPSExplosionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Queues a radial impulse at Center, Source is ignored by the queries */
+	void Explode(AActor* Source, const FVector& Center, float Radius, float Strength, ERadialImpulseFalloff Falloff);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	/** Returns false while some traces are still in flight */
+	bool TryApplyImpulses(FFPSExplosion& Explosion);
+
+	/** Returns false while the overlap is still in flight */
+	bool TryIssueTraces(FFPSExplosion& Explosion);
+
+	/** Fraction of Target's samples with a clear line to the blast, 1 when occlusion is off. Returns false while traces are in flight */
+	bool TryGetExposure(const FFPSExplosionTarget& Target, float& OutExposure) const;
+
+	TArray<FFPSExplosion> Explosions;
+
+	/** Scratch list reused every frame */
+	TArray<float> Exposures;
+};
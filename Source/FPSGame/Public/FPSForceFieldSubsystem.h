@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "Engine/EngineTypes.h"
+#include "FPSForceFieldSubsystem.generated.h"
+
+class UPrimitiveComponent;
+class UCharacterMovementComponent;
+
+/** A registered radial force, Strength < 0 pulls towards Center */
+struct FFPSForceField
+{
+	int32 Id = INDEX_NONE;
+
+	/** Ignored by the field's own overlap, the field is dropped when it goes away */
+	TWeakObjectPtr<AActor> Owner;
+
+	FVector Center = FVector::ZeroVector;
+
+	/** Where the overlap that finds bodies is centred, usually Center */
+	FVector QueryCenter = FVector::ZeroVector;
+
+	float Radius = 0.0f;
+	float Strength = 0.0f;
+	ERadialImpulseFalloff Falloff = RIF_Constant;
+
+	/** Paused fields keep their registration but neither query nor push anything */
+	bool bPaused = false;
+
+	/** Overlap issued last frame, consumed at the start of the next tick */
+	FTraceHandle OverlapHandle;
+};
+
+/**
+ * Bodies inside at least one field, all arrays share the same index.
+ * Kept across frames: a body is classified once when it enters and dropped once no field has seen it for a few frames.
+ */
+struct FFPSForceFieldBodies
+{
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+
+	TArray<float> AccelX;
+	TArray<float> AccelY;
+	TArray<float> AccelZ;
+
+	TArray<TWeakObjectPtr<AActor>> Actors;
+
+	/** Physics body to push, null for characters */
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> Components;
+
+	/** Character movement to push, null for physics bodies */
+	TArray<TWeakObjectPtr<UCharacterMovementComponent>> CharacterMovements;
+
+	/** Subsystem tick a field overlap last returned the body */
+	TArray<uint32> LastSeenTicks;
+
+	int32 Num() const { return X.Num(); }
+
+	int32 Add(AActor* Actor, UPrimitiveComponent* Component, UCharacterMovementComponent* CharacterMovement, uint32 SeenTick);
+
+	void RemoveAtSwap(int32 Index);
+
+	void Reset();
+};
+
+/**
+ * Applies the radial forces of black holes and similar fields.
+ * Every field issues one async overlap per frame. Bodies are classified once when they enter a field and kept until they leave,
+ * the contribution of every field is summed per body and each body receives a single force, however many fields it is in.
+ */
+UCLASS()
+class FPSGAME_API UFPSForceFieldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Starts applying a radial force, returns the id to move or remove it with */
+	int32 AddField(AActor* Owner, const FVector& Center, float Radius, float Strength, ERadialImpulseFalloff Falloff);
+
+	/** Moves the field, its query keeps its offset from the center */
+	void MoveField(int32 FieldId, const FVector& Center);
+
+	/** Finds bodies around QueryCenter instead, they are still pushed relative to the field's center */
+	void SetFieldQueryCenter(int32 FieldId, const FVector& QueryCenter);
+
+	void RemoveField(int32 FieldId);
+
+	void SetFieldPaused(int32 FieldId, bool bPaused);
+
+	int32 GetNumFields() const { return Fields.Num(); }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	FFPSForceField* FindField(int32 FieldId);
+
+	/** Consumes the field overlaps, adding bodies that entered and refreshing the ones still inside */
+	void GatherBodies();
+
+	/** Drops bodies that left every field or went away, refreshes the positions of the others */
+	void UpdateBodies();
+
+	/** Works out once whether Actor is pushed as a character or as a physics body, returns false if it's neither */
+	bool AddBody(AActor* Actor);
+
+	void AccumulateForces();
+
+	void ApplyForces();
+
+	void IssueOverlaps();
+
+	TArray<FFPSForceField> Fields;
+
+	int32 NextFieldId = 1;
+
+	FFPSForceFieldBodies Bodies;
+	TMap<TWeakObjectPtr<AActor>, int32> BodyIndices;
+
+	/** Overlapped actors that can't be pushed (walls, kinematic props), with the tick they were last seen */
+	TMap<TWeakObjectPtr<AActor>, uint32> IgnoredActors;
+
+	uint32 TickCount = 0;
+};
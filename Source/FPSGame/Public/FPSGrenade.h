@@ -4,13 +4,14 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "FPSThrowable.h"
 #include "FPSGrenade.generated.h"
 
 class UProjectileMovementComponent;
 class USphereComponent;
 
 UCLASS()
-class FPSGAME_API AFPSGrenade : public AActor
+class FPSGAME_API AFPSGrenade : public AActor, public IFPSThrowable
 {
 	GENERATED_BODY()
 	
@@ -26,9 +27,6 @@ protected:
 	UPROPERTY(VisibleAnywhere, Category= "Components")
 	USphereComponent* CollisionComp;
 
-	UPROPERTY(VisibleAnywhere, Category = "Components")
-	USphereComponent* OuterSphereComponent;
-
 	UPROPERTY(EditDefaultsOnly, Category= "Components")
 	UStaticMeshComponent* GrenadeMesh;
 
@@ -60,4 +58,19 @@ protected:
 
 	UFUNCTION()
  	void OnExplode();
+
+	void StartFuze();
+
+public:
+	virtual void OnAcquiredFromPool() override;
+
+	virtual void OnReturnedToPool() override;
+
+	virtual float GetFuzeTime() const override { return MaxFuzeTime; }
+
+	virtual bool MaterializeOnAnyHit() const override { return false; }
+
+	virtual bool MakesNoiseOnHit() const override { return true; }
+
+	virtual void OnMaterialized(float RemainingFuzeTime) override;
 };
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPSGuardCrowdSubsystem.generated.h"
+
+class AFPSAIGuard;
+class AFPSPatrolRoute;
+
+/** Baked paths of a patrol route joined into one loop of waypoints */
+struct FFPSCrowdRoute
+{
+	TWeakObjectPtr<AFPSPatrolRoute> Route;
+
+	TArray<FVector> Waypoints;
+
+	/** Route point a guard walking to each waypoint is heading for, handed back to the guard on promotion */
+	TArray<int32> PointIndices;
+
+	/** Waypoint of each route point */
+	TArray<int32> PointWaypoints;
+};
+
+/** Structure-of-arrays storage for idle and patrolling guards without an actor, all arrays share the same index */
+struct FFPSCrowdGuards
+{
+	TArray<FVector> Positions;
+	TArray<float> Yaws;
+	TArray<float> Speeds;
+
+	/** From the navmesh up to the actor location */
+	TArray<float> HeightOffsets;
+
+	/** Farthest a noise of loudness 1 is heard */
+	TArray<float> HearingRanges;
+
+	/** INDEX_NONE for guards standing still */
+	TArray<int32> RouteIndices;
+	TArray<int32> Waypoints;
+
+	TArray<uint8> Promote;
+	TArray<TWeakObjectPtr<UClass>> Classes;
+
+	/** Parked actor of placed guards, null for guards spawned back from Classes */
+	TArray<TWeakObjectPtr<AFPSAIGuard>> Actors;
+
+	int32 Num() const { return Positions.Num(); }
+
+	void RemoveAtSwap(int32 Index);
+
+	void Reset();
+};
+
+/**
+ * Simulates idle and patrolling guards far from every player as plain data instead of full characters with a controller,
+ * movement, mesh and sensing.
+ * Dormant idle guards are handed over by the guard itself, their patrols are walked along the baked route paths in one parallel
+ * pass per frame, and a guard is brought back as an actor, where it was and heading for the same point, as soon as a player gets
+ * within the promotion radius or it would hear a noise. Guards only become Suspicious or Alerted as actors.
+ * Guards placed in the level keep their actor, parked hidden with everything turned off, so their instance settings and net
+ * startup name survive. Guards spawned at runtime are destroyed and spawned again.
+ * Server only, clients see parked guards hidden and crowd guards not at all.
+ */
+UCLASS()
+class FPSGAME_API UFPSGuardCrowdSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Hands Guard over to the crowd once it can join and no player is near, until CancelDemotion */
+	void QueueDemotion(AFPSAIGuard* Guard);
+
+	void CancelDemotion(AFPSAIGuard* Guard);
+
+	/** Promotes the crowd guards that would hear this noise, before it is routed to the listening guards */
+	void PromoteListeners(const FVector& Location, float Loudness, float MaxRange);
+
+	UFUNCTION(BlueprintPure, Category = "AI")
+	int32 GetNumCrowdGuards() const { return Guards.Num(); }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	void GatherPlayers();
+
+	bool IsPlayerWithin(const FVector& Location, float Radius) const;
+
+	/** Stores the guard as data and parks or destroys its actor */
+	void Demote(AFPSAIGuard* Guard);
+
+	/** Moves the patrolling guards along their waypoints and flags the ones a player got close to */
+	void Simulate(float DeltaTime, float PromotionRadius);
+
+	/** Brings the guard back as an actor, parked or spawned, and removes it from the crowd */
+	void Promote(int32 Index);
+
+	int32 FindOrAddRoute(AFPSPatrolRoute* Route);
+
+	FFPSCrowdGuards Guards;
+
+	TArray<FFPSCrowdRoute> Routes;
+
+	/** Dormant guards waiting until they can join */
+	TArray<TWeakObjectPtr<AFPSAIGuard>> PendingDemotions;
+
+	/** Player view target locations gathered once per frame */
+	TArray<FVector> PlayerLocations;
+};
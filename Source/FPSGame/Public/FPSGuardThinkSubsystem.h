@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPSAIGuard.h"
+#include "FPSGuardThinkSubsystem.generated.h"
+
+/** What a guard knows when it thinks, copied off the actor on the game thread */
+struct FFPSGuardThinkInput
+{
+	EAIState State = EAIState::Idle;
+
+	FVector Location = FVector::ZeroVector;
+	FRotator OriginalRotation = FRotator::ZeroRotator;
+
+	/** Sensed since the last think */
+	bool bSawPawn = false;
+	bool bHeardNoise = false;
+	FVector NoiseLocation = FVector::ZeroVector;
+
+	/** World time a Suspicious guard gives up and goes back to Idle */
+	float SuspiciousUntil = 0.0f;
+	float SuspicionDuration = 0.0f;
+};
+
+/** What a guard decided, committed to the actor on the game thread */
+struct FFPSGuardThinkAction
+{
+	EAIState NewState = EAIState::Idle;
+
+	bool bSetRotation = false;
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	float SuspiciousUntil = 0.0f;
+
+	/** Tell the game mode about the pawn we saw */
+	bool bReportSpotted = false;
+
+	bool bStopMovement = false;
+	bool bResumePatrol = false;
+
+	/** Think again next frame, while waiting for suspicion to wear off */
+	bool bStayAwake = false;
+};
+
+/**
+ * Runs the state machine of every guard that has something to think about in one batch per frame.
+ * Guards only record what they sensed and wake themselves up. Their inputs are gathered into a snapshot, evaluated in parallel
+ * on the task graph with no access to the actors, and the resulting actions (rotation, state, movement) are committed back on
+ * the game thread.
+ */
+UCLASS()
+class FPSGAME_API UFPSGuardThinkSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Has Guard think at the end of this frame */
+	void Wake(AFPSAIGuard* Guard);
+
+	/** The guard state machine, pure so it can run on any thread */
+	static FFPSGuardThinkAction Think(const FFPSGuardThinkInput& Input, float Now);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	TArray<TWeakObjectPtr<AFPSAIGuard>> AwakeGuards;
+
+	/** Snapshot of this frame's thinkers, reused to avoid allocating every frame */
+	TArray<AFPSAIGuard*> Thinkers;
+	TArray<FFPSGuardThinkInput> Inputs;
+	TArray<FFPSGuardThinkAction> Actions;
+};
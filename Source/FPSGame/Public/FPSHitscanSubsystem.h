@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "FPSHitscanSubsystem.generated.h"
+
+/** One hitscan shot, from request to resolved hit */
+struct FFPSHitscanShot
+{
+	/** Ignored by the trace, and by lag compensation when it is a registered character */
+	TWeakObjectPtr<AActor> Shooter;
+
+	/** Also ignored, the weapon for shots fired by an AFPSWeapon */
+	TWeakObjectPtr<AActor> IgnoredActor;
+
+	FVector Start = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+	float Distance = 0.0f;
+
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	/** Velocity change given to what is hit */
+	float Impulse = 0.0f;
+
+	/** Server world time the shooter saw, targets are rewound to it */
+	float Timestamp = 0.0f;
+
+	/** Makes the noise guards hear once the shot is resolved, the weapon or the shooter */
+	TWeakObjectPtr<AActor> NoiseMaker;
+
+	float NoiseLoudness = 0.0f;
+
+	FTraceHandle TraceHandle;
+};
+
+/**
+ * Resolves hitscan shots without blocking the game thread.
+ * Shots queued during a frame are issued together as async traces at the end of it and resolved (noise, impulse and debug
+ * drawing) the frame after, with the characters tested as lag compensated hitboxes.
+ */
+UCLASS()
+class FPSGAME_API UFPSHitscanSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	void QueueShot(AActor* Shooter, AActor* IgnoredActor, const FVector& Start, const FVector& Direction, float Distance, float Timestamp, ECollisionChannel TraceChannel, float Impulse, AActor* NoiseMaker, float NoiseLoudness);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	void IssueShots();
+
+	/** Returns false while the trace is still in flight */
+	bool TryResolveShot(const FFPSHitscanShot& Shot);
+
+	void ApplyHit(const FFPSHitscanShot& Shot, const FHitResult& Hit);
+
+	/** Queued this frame, traced at the end of it */
+	TArray<FFPSHitscanShot> QueuedShots;
+
+	/** Traced, waiting for their results */
+	TArray<FFPSHitscanShot> InFlightShots;
+};
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPSLagCompensationSubsystem.generated.h"
+
+class ACharacter;
+class USkeletalMeshComponent;
+struct FCollisionQueryParams;
+struct FHitResult;
+
+/** Capsule of a character at one server frame */
+struct FFPSHitboxSnapshot
+{
+	float Time;
+	FVector Location;
+	float Radius;
+	float HalfHeight;
+};
+
+/** Fixed-size ring of the last snapshots of one character, allocated once on registration */
+struct FFPSHitboxHistory
+{
+	TWeakObjectPtr<ACharacter> Character;
+
+	TArray<FFPSHitboxSnapshot> Snapshots;
+
+	/** World transform of every physics asset body of the mesh, NumBodies per snapshot slot */
+	TArray<FTransform> BodyTransforms;
+
+	/** Bodies of the mesh when it registered, 0 for meshes without a physics asset, which are hit as capsules */
+	int32 NumBodies = 0;
+
+	/** Slot the next snapshot is written to */
+	int32 Head = 0;
+
+	int32 Num = 0;
+
+	/** Returns the slot written, for the body transforms of the same frame */
+	int32 Record(const FFPSHitboxSnapshot& Snapshot);
+
+	/** The two slots around Time and how far between them, clamped to the oldest and newest. Returns false if nothing was recorded yet */
+	bool FindSlots(float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const;
+
+	/** Capsule and bodies interpolated between two slots from FindSlots */
+	FFPSHitboxSnapshot SampleCapsule(int32 Older, int32 Newer, float Alpha) const;
+
+	FTransform SampleBody(int32 Older, int32 Newer, float Alpha, int32 Body) const;
+};
+
+/**
+ * Server-side hitbox history for lag compensated hitscan.
+ * Every frame the capsule and the physics asset bodies of each registered character are written to its ring buffer. Traces rewind
+ * them to the time the shooter saw: the capsule is only the broad phase, then every body of the mesh that blocks the Hitbox
+ * channel is traced with its real simple shapes, the trace moved from the rewound body into the body as it is now. Nothing is
+ * moved in the physics scene and there is nothing to restore. Meshes without a physics asset are hit as their rewound capsule.
+ */
+UCLASS()
+class FPSGAME_API UFPSLagCompensationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	void Register(ACharacter* Character);
+
+	void Unregister(ACharacter* Character);
+
+	/**
+	 * Traces the world with characters as they were at Timestamp (server world time).
+	 * Static geometry is traced as it is now, registered characters as rewound hitboxes. Returns true on a blocking hit
+	 */
+	bool RewindTrace(const FVector& Start, const FVector& End, float Timestamp, const AActor* Shooter, FHitResult& OutHit) const;
+
+	/** Timestamp clamped to how far back shots can be rewound, and to now */
+	float ClampTimestamp(float Timestamp) const;
+
+	/** Ignores every registered character, for world traces whose characters are tested with TraceHitboxes instead */
+	void AddIgnoredCharacters(FCollisionQueryParams& QueryParams) const;
+
+	/** Tests only the rewound hitboxes. Returns true and fills OutHit, with the bone hit, if one is hit closer than MaxDistance */
+	bool TraceHitboxes(const FVector& Start, const FVector& End, float Timestamp, const AActor* Shooter, float MaxDistance, FHitResult& OutHit) const;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	/** Traces the Hitbox bodies of Mesh as they were between the two slots, the hit is reported on the bodies as they are now */
+	bool TraceBodies(const FFPSHitboxHistory& History, USkeletalMeshComponent* Mesh, int32 Older, int32 Newer, float Alpha, const FVector& Start, const FVector& End, float MaxDistance, FHitResult& OutHit) const;
+
+	TArray<FFPSHitboxHistory> Histories;
+};
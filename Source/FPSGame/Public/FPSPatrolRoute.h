@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FPSPatrolRoute.generated.h"
+
+class USceneComponent;
+
+/** Navmesh path from one patrol point to the next, with the ends it was built for so moved points are noticed */
+USTRUCT()
+struct FFPSPatrolSegment
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector Start = FVector::ZeroVector;
+
+	UPROPERTY()
+	FVector End = FVector::ZeroVector;
+
+	UPROPERTY()
+	TArray<FVector> PathPoints;
+};
+
+/**
+ * Ordered loop of points guards patrol along.
+ * The navmesh path between consecutive points is baked in the editor with Build Paths, or at level load for segments that are
+ * missing or out of date, so a guard only follows stored paths and never scans the world or queries the navmesh itself.
+ */
+UCLASS()
+class FPSGAME_API AFPSPatrolRoute : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFPSPatrolRoute();
+
+	int32 GetNumPoints() const { return Points.Num(); }
+
+	FVector GetPointLocation(int32 Index) const;
+
+	/** Wraps from the last point back to the first, INDEX_NONE for an empty route */
+	int32 GetNextPointIndex(int32 Index) const { return Points.Num() > 0 ? (Index + 1) % Points.Num() : INDEX_NONE; }
+
+	/**
+	 * Path from point Index to the next one, a straight line if the navmesh had none. Bakes the segment first when it is missing or
+	 * stale, e.g. asked for by a guard whose BeginPlay ran before ours. Empty for an index outside the route
+	 */
+	TArray<FVector> GetPathFromPoint(int32 Index);
+
+	/** Bakes the path of every segment that is missing or whose points moved */
+	UFUNCTION(CallInEditor, Category = "Patrol")
+	void BuildPaths();
+
+protected:
+	virtual void BeginPlay() override;
+
+	UPROPERTY(VisibleAnywhere, Category = "Components")
+	USceneComponent* SceneComponent;
+
+	/** Patrolled in order, the last one leads back to the first */
+	UPROPERTY(EditInstanceOnly, Category = "Patrol", meta = (MakeEditWidget))
+	TArray<FVector> Points;
+
+	UPROPERTY(VisibleInstanceOnly, Category = "Patrol")
+	TArray<FFPSPatrolSegment> Segments;
+
+	bool IsSegmentUpToDate(int32 Index) const;
+};
@@ -0,0 +1,206 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "FPSPerceptionSubsystem.generated.h"
+
+class UPawnSensingComponent;
+class APawn;
+class AFPSVisibilityGrid;
+
+/** A pawn sensing component whose sight and hearing are handled here */
+struct FFPSPerceptionObserver
+{
+	TWeakObjectPtr<UPawnSensingComponent> Sensing;
+
+	/** The component's bSeePawns and bHearNoises when it registered, the component itself no longer senses anything */
+	bool bSeePawns = true;
+	bool bHearNoises = true;
+
+	/** Off for dormant observers, hearing is cheap and stays on so a noise can still wake them */
+	bool bSightEnabled = true;
+
+	/** World time of the next sight update, intervals are read from the component so SetSensingInterval still applies */
+	float NextSenseTime = 0.0f;
+};
+
+/** Line of sight trace for an observer and a pawn that passed the range and view cone test */
+struct FFPSSightQuery
+{
+	TWeakObjectPtr<UPawnSensingComponent> Sensing;
+	TWeakObjectPtr<APawn> Pawn;
+	FTraceHandle TraceHandle;
+};
+
+/** A MakeNoise call, queued until the end of the frame */
+struct FFPSNoiseEvent
+{
+	TWeakObjectPtr<APawn> Instigator;
+	FVector Location = FVector::ZeroVector;
+	float Loudness = 0.0f;
+
+	/** 0 for no limit beyond the listeners' hearing thresholds */
+	float MaxRange = 0.0f;
+};
+
+/** Last noise routed in one throttle slot */
+struct FFPSNoiseSlot
+{
+	float Time = 0.0f;
+	float Loudness = 0.0f;
+	FVector Location = FVector::ZeroVector;
+};
+
+/** Last noises routed for one instigator, like UPawnNoiseEmitterComponent one slot for its own noises and one for the rest */
+struct FFPSNoiseRecord
+{
+	/** Made by the instigator itself, footsteps and shots */
+	FFPSNoiseSlot Local;
+
+	/** Made by something it set off, bounces and explosions */
+	FFPSNoiseSlot Remote;
+};
+
+/** A noise delivered to a listener, or waiting for its line of sight trace when it is only loud enough to be heard in the open */
+struct FFPSHeardNoise
+{
+	TWeakObjectPtr<UPawnSensingComponent> Sensing;
+	TWeakObjectPtr<APawn> Instigator;
+	FVector Location = FVector::ZeroVector;
+	float Loudness = 0.0f;
+	FTraceHandle TraceHandle;
+};
+
+/** Pawns that can be seen this frame, all arrays share the same index */
+struct FFPSPerceptionTargets
+{
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+
+	TArray<APawn*> Pawns;
+
+	/** Next pawn in the same grid cell, INDEX_NONE ends the cell */
+	TArray<int32> NextInCell;
+
+	int32 Num() const { return X.Num(); }
+
+	void Reset();
+};
+
+/**
+ * Sight and hearing for every pawn sensing component, in one pass per frame instead of one pawn loop and synchronous trace per guard.
+ * Pawns are bucketed into a grid, each due observer only tests the cells its sight radius covers with a branch-free range and
+ * view cone pass, and the pairs left are checked with async line of sight traces whose results are broadcast through the
+ * component's OnSeePawn the frame after.
+ * Noises are queued and routed once per frame to the listeners in the cells they reach, heard noises are broadcast together
+ * through OnHearNoise.
+ * With a baked AFPSVisibilityGrid in the level, pairs of places that can never see each other skip their trace.
+ */
+UCLASS()
+class FPSGAME_API UFPSPerceptionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** Takes over the sight and hearing of Sensing, its bSeePawns and bHearNoises are turned off and its delegates broadcast from here */
+	void RegisterObserver(UPawnSensingComponent* Sensing);
+
+	void UnregisterObserver(UPawnSensingComponent* Sensing);
+
+	/** Observers with sight disabled keep their registration and their hearing, but don't look for pawns */
+	void SetObserverSightEnabled(UPawnSensingComponent* Sensing, bool bEnabled);
+
+	/** Pairs the grid says can never see each other are rejected before any line of sight trace, nullptr traces everything */
+	void SetVisibilityGrid(AFPSVisibilityGrid* Grid) { VisibilityGrid = Grid; }
+
+	/**
+	 * Queues a noise for this frame's routing, every MakeNoise of the world ends up here.
+	 * Like a pawn noise emitter, an instigator is heard at most once per fps.Perception.NoiseInterval for the noises it makes
+	 * itself and once for the noises of anything else, unless the noise is louder or somewhere else
+	 */
+	void ReportNoise(AActor* NoiseMaker, APawn* Instigator, const FVector& Location, float Loudness, float MaxRange);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	/** Broadcasts the traces issued last frame that found a clear line */
+	void ResolveQueries();
+
+	void BuildGrid(float CellSize);
+
+	/** Gathers the pawns of the cells around the observer and issues traces for the ones in its view */
+	void SenseFrom(UPawnSensingComponent* Sensing, float CellSize);
+
+	/** Branch-free range and view cone test over the candidates, writes 1 to OutVisible for the ones that pass */
+	void CullCandidates(const FVector& Eye, const FVector& Forward, float RadiusSq, float PeripheralVisionCosine);
+
+	/** Routes the queued noises to the listeners in range, the ones that need a clear line are traced */
+	void RouteNoises(float CellSize);
+
+	/** Listens to the noises that passed their line of sight trace */
+	void ResolveHearingQueries();
+
+	/** Broadcasts OnHearNoise for every noise heard this frame */
+	void DeliverHeardNoises();
+
+	static FIntPoint GetCell(float X, float Y, float CellSize);
+
+	/** Replaces the engine's MakeNoise handler, forwards to the subsystem of the noise maker's world */
+	static void RouteNoise(AActor* NoiseMaker, float Loudness, APawn* NoiseInstigator, const FVector& NoiseLocation, float MaxRange, FName Tag);
+
+	/** Subsystems alive in any world, the engine's handler is put back when the last one goes */
+	static int32 NumNoiseRoutingSubsystems;
+
+	TArray<FFPSPerceptionObserver> Observers;
+
+	TWeakObjectPtr<AFPSVisibilityGrid> VisibilityGrid;
+
+	/** Traces skipped thanks to the visibility grid this frame */
+	int32 NumVisibilityRejections = 0;
+
+	TArray<FFPSSightQuery> Queries;
+
+	FFPSPerceptionTargets Targets;
+
+	/** First target of each occupied cell */
+	TMap<FIntPoint, int32> CellHeads;
+
+	TArray<FFPSNoiseEvent> NoiseEvents;
+
+	TMap<TWeakObjectPtr<APawn>, FFPSNoiseRecord> LastNoises;
+
+	/** Noises waiting for their line of sight trace */
+	TArray<FFPSHeardNoise> HearingQueries;
+
+	/** Heard this frame, broadcast in one batch at the end of the tick */
+	TArray<FFPSHeardNoise> HeardNoises;
+
+	/** Listening observers bucketed like the sight targets, rebuilt on frames with noises */
+	TArray<float> ListenerX;
+	TArray<float> ListenerY;
+	TArray<float> ListenerZ;
+	TArray<int32> ListenerObservers;
+	TArray<int32> ListenerNextInCell;
+	TMap<FIntPoint, int32> ListenerCellHeads;
+
+	/** Scratch for one observer's candidates, reused to avoid allocating every frame */
+	TArray<int32> CandidateIndices;
+	TArray<float> CandidateX;
+	TArray<float> CandidateY;
+	TArray<float> CandidateZ;
+	TArray<uint8> CandidateVisible;
+};
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "FPSThrowable.h"
 #include "FPSProjectile.generated.h"
 
 
@@ -11,8 +13,33 @@ class UProjectileMovementComponent;
 class USphereComponent;
 class UStaticMeshComponent;
 
+/** Quantized launch of a projectile, sent once per throw (and per bounce or impact) instead of streaming movement */
+USTRUCT()
+struct FFPSProjectileLaunchState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 Origin;
+
+	UPROPERTY()
+	FVector_NetQuantizeNormal Direction;
+
+	/** Whole units per second */
+	UPROPERTY()
+	uint16 Speed = 0;
+
+	/** Server world time the projectile was at Origin */
+	UPROPERTY()
+	float ServerTime = 0.0f;
+
+	/** Bumped on every update so a reused pool actor always replicates, even from the same spot */
+	UPROPERTY()
+	uint8 Sequence = 0;
+};
+
 UCLASS()
-class FPSGAME_API AFPSProjectile : public AActor
+class FPSGAME_API AFPSProjectile : public AActor, public IFPSThrowable
 {
 	GENERATED_BODY()
 
@@ -25,11 +52,37 @@ public:
 	/** Returns ProjectileMovement subobject **/
 	UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
 
+	/** Id of the client-side proxy this projectile answers, 0 if the throw wasn't predicted */
+	uint8 GetPredictionId() const { return PredictionId; }
+
+	void SetPredictionId(uint8 NewPredictionId);
+
+	/** Seconds of flight since the server's launch that the current location accounts for, on clients placed from the launch state */
+	float GetReplicatedFlightTime() const;
+
+	/** Draws the mesh at PredictedLocation and eases it back onto the actor over BlendTime */
+	void BlendFromPredictedLocation(const FVector& PredictedLocation, float BlendTime);
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual void OnAcquiredFromPool() override;
+
+	virtual void OnReturnedToPool() override;
+
+	virtual bool MakesNoiseOnHit() const override { return true; }
+
+	virtual void OnMaterialized(float RemainingFuzeTime) override;
+
 protected:
+	virtual void BeginPlay() override;
+
 	/** called when projectile hits something */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
+	/** Returns the projectile to the pool instead of destroying it */
+	virtual void LifeSpanExpired() override;
+
 	/** Sphere collision component */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category= "Projectile")
 	USphereComponent* CollisionComp;
@@ -40,5 +93,36 @@ protected:
 
 	UPROPERTY(VisibleAnywhere, Category= "Projectile")
 	UStaticMeshComponent* ProjectileMesh;
+
+	/** Longest flight time a client fast-forwards when a launch arrives, anything older is mostly lag and is skipped */
+	UPROPERTY(EditDefaultsOnly, Category = "Projectile")
+	float MaxLaunchCatchUpTime;
+
+	/** Declared before PredictionId so clients have placed the projectile before reconciling their prediction */
+	UPROPERTY(ReplicatedUsing = OnRep_LaunchState)
+	FFPSProjectileLaunchState LaunchState;
+
+	UFUNCTION()
+	void OnRep_LaunchState();
+
+	/** Captures the current location and velocity and sends them to clients, does nothing off the server */
+	void UpdateLaunchState();
+
+	UFUNCTION()
+	void OnBounce(const FHitResult& ImpactResult, const FVector& ImpactVelocity);
+
+	UPROPERTY(ReplicatedUsing = OnRep_PredictionId)
+	uint8 PredictionId;
+
+	UFUNCTION()
+	void OnRep_PredictionId();
+
+	/* Offset between the predicted proxy and this projectile when reconciled, blended out over PredictionBlendTime */
+	FVector PredictionOffset;
+	FVector MeshRelativeLocation;
+	float PredictionBlendTime;
+	float PredictionBlendTimeLeft;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 };
 
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FPSProjectilePoolSubsystem.generated.h"
+
+USTRUCT(BlueprintType)
+struct FFPSProjectilePoolStats
+{
+	GENERATED_BODY()
+
+	/** Acquires served from a parked instance */
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 Hits = 0;
+
+	/** Acquires that had to spawn a new actor */
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 Misses = 0;
+
+	/** Actors parked after hit, explode or lifespan expiry */
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 Returns = 0;
+
+	/** Actors destroyed because their class pool was already full */
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 Overflows = 0;
+};
+
+/**
+ * Per-world pool of throwable actors (projectiles and grenades).
+ * Parked actors are hidden, have collision, ticking and movement disabled and are net dormant until handed out again.
+ */
+UCLASS()
+class FPSGAME_API UFPSProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Spawns and parks instances of Class until at least Count are available */
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	void Prewarm(TSubclassOf<AActor> Class, int32 Count);
+
+	/** Hands out a parked instance of Class placed at SpawnTransform, spawning a new one if none is parked */
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	AActor* Acquire(TSubclassOf<AActor> Class, const FTransform& SpawnTransform, APawn* InInstigator);
+
+	/** Parks Actor for reuse. Returns false if the actor can't be pooled and should be destroyed instead */
+	UFUNCTION(BlueprintCallable, Category = "Pool")
+	bool Release(AActor* Actor);
+
+	UFUNCTION(BlueprintPure, Category = "Pool")
+	FFPSProjectilePoolStats GetStats() const { return Stats; }
+
+	/** Number of instances of Class currently parked */
+	int32 GetNumParked(TSubclassOf<AActor> Class) const;
+
+	/** Returns Actor to its world's pool if it is poolable, otherwise destroys it */
+	static void ReturnOrDestroy(AActor* Actor);
+
+protected:
+	AActor* SpawnPooledActor(TSubclassOf<AActor> Class, const FTransform& SpawnTransform, APawn* InInstigator);
+
+	void WakeActor(AActor* Actor, const FTransform& SpawnTransform, APawn* InInstigator);
+
+	void ParkActor(AActor* Actor);
+
+	TMap<TWeakObjectPtr<UClass>, TArray<TWeakObjectPtr<AActor>>> ParkedActors;
+
+	TSet<TWeakObjectPtr<AActor>> ParkedLookup;
+
+	FFPSProjectilePoolStats Stats;
+};
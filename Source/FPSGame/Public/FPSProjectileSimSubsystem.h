@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "FPSProjectileSimSubsystem.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/** Movement and collision settings read once from a throwable class default object */
+struct FFPSSimulatedClassInfo
+{
+	TWeakObjectPtr<UClass> Class;
+
+	float Radius = 5.0f;
+	float InitialSpeed = 0.0f;
+	float MaxSpeed = 0.0f;
+	float GravityScale = 1.0f;
+	float Bounciness = 0.6f;
+	float Friction = 0.2f;
+	float StopSimulatingThreshold = 5.0f;
+	float FuzeTime = 0.0f;
+	float LifeSpan = 0.0f;
+
+	bool bShouldBounce = false;
+	bool bMaterializeOnAnyHit = true;
+	bool bMakesNoiseOnHit = false;
+
+	ECollisionChannel CollisionChannel = ECC_WorldDynamic;
+	FCollisionResponseParams ResponseParams;
+
+	/** Cosmetic instances drawn in place of actors, only created where something renders */
+	TWeakObjectPtr<UInstancedStaticMeshComponent> Cosmetics;
+	FTransform MeshRelativeTransform;
+};
+
+/** Structure-of-arrays storage for in-flight projectiles, all arrays share the same index */
+struct FFPSSimulatedProjectiles
+{
+	TArray<FVector> Positions;
+	TArray<FVector> PreviousPositions;
+	TArray<FVector> Velocities;
+	TArray<float> GravityZ;
+	TArray<float> MaxSpeeds;
+	TArray<float> FuzeTimes;
+	TArray<float> LifeSpans;
+	TArray<uint8> BounceCounts;
+	TArray<uint8> AtRest;
+	TArray<int32> ClassIndices;
+	TArray<FTraceHandle> SweepHandles;
+	TArray<TWeakObjectPtr<APawn>> Instigators;
+	TArray<uint8> PredictionIds;
+	TArray<uint8> CosmeticOnly;
+
+	int32 Num() const { return Positions.Num(); }
+
+	int32 Add(const FVector& Position, const FVector& Velocity, float InGravityZ, float MaxSpeed, float FuzeTime, float LifeSpan, int32 ClassIndex, APawn* Instigator, uint8 PredictionId, bool bCosmeticOnly);
+
+	void RemoveAtSwap(int32 Index);
+
+	void Reset();
+};
+
+/**
+ * Flies throwables in batches without spawning an actor per projectile.
+ * All projectiles are integrated in one pass per frame and swept with async traces that are consumed the next frame.
+ * An actor is only taken from the projectile pool when a projectile hits something that needs gameplay (a pawn, a physics body,
+ * or any hit for throwables that don't bounce) or when its fuze runs out.
+ * Clients fly a cosmetic copy of each server launch, see LaunchCosmetic.
+ */
+UCLASS()
+class FPSGAME_API UFPSProjectileSimSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/**
+	 * Starts simulating a throwable of Class. Returns false if the class can't be simulated or the budget is used up.
+	 * PredictionId is handed to the projectile when it materializes, so the thrower can reconcile its proxy with it.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Projectile")
+	bool Launch(TSubclassOf<AActor> Class, const FVector& Location, const FRotator& Rotation, APawn* InInstigator, uint8 PredictionId = 0);
+
+	/**
+	 * Flies a throwable the server launched in its simulation, for looks only on clients since the sim doesn't replicate.
+	 * It never materializes, the server's actor replicates in about where this one is dropped. ElapsedTime is how long ago the
+	 * server launched it.
+	 */
+	void LaunchCosmetic(TSubclassOf<AActor> Class, const FVector& Location, const FRotator& Rotation, APawn* InInstigator, float ElapsedTime);
+
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+	int32 GetNumSimulated() const { return Projectiles.Num(); }
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	int32 FindOrAddClassInfo(UClass* Class);
+
+	void ResolveSweeps();
+
+	void AddRemoval(int32 Index, bool bMaterialize);
+
+	void Integrate(float DeltaTime);
+
+	void IssueSweeps();
+
+	void Materialize(int32 Index);
+
+	void UpdateCosmetics();
+
+	TArray<FFPSSimulatedClassInfo> ClassInfos;
+
+	FFPSSimulatedProjectiles Projectiles;
+
+	struct FPendingRemoval
+	{
+		int32 Index;
+		bool bMaterialize;
+	};
+
+	/** Scratch lists reused every frame so the steady state doesn't allocate */
+	TArray<FPendingRemoval> PendingRemovals;
+	TArray<int32> CosmeticInstanceCounts;
+
+	TWeakObjectPtr<AActor> CosmeticsActor;
+};
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BasicReplicationGraph.h"
+#include "FPSReplicationGraph.generated.h"
+
+/**
+ * Replication graph for FPSGame, so the server gathers the actors relevant to each connection from a few nodes instead of
+ * testing every actor against every connection.
+ * Characters and throwables go in the spatial grid as dynamic actors, throwables with a short cull distance. Guards go in the
+ * grid through its dormancy path and replicate at a lower frequency. The game state, player states and the objective are
+ * always relevant, owner-only actors are relevant to their own connection.
+ * Enabled through ReplicationDriverClassName of the net driver in DefaultEngine.ini, the settings below can be overridden in its
+ * [/Script/FPSGame.FPSReplicationGraph] section.
+ */
+UCLASS(Transient, Config = Engine)
+class FPSGAME_API UFPSReplicationGraph : public UBasicReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UFPSReplicationGraph();
+
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+protected:
+	/** Size of the spatial grid cells, close to the shortest cull distance keeps the cells a viewer gathers small */
+	UPROPERTY(Config)
+	float GridCellSize;
+
+	UPROPERTY(Config)
+	float CharacterCullDistance;
+
+	/** Projectiles and grenades only matter close to the viewer */
+	UPROPERTY(Config)
+	float ThrowableCullDistance;
+
+	UPROPERTY(Config)
+	float GuardCullDistance;
+
+	/** Guards only change with their state and while walking, they don't need every frame */
+	UPROPERTY(Config)
+	float GuardNetUpdateFrequency;
+
+	/** Characters and throwables move every frame and skip the dormancy bookkeeping of the grid */
+	static bool IsDynamic(const UClass* Class);
+
+	static bool IsAlwaysRelevant(const UClass* Class);
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "FPSSignificant.h"
+#include "FPSSignificanceSubsystem.generated.h"
+
+/**
+ * Scores registered actors by distance to the nearest player view, with actors behind every player counted further away.
+ * Only a budgeted number of actors are scored per frame, round robin, and they are told when their bucket changes.
+ */
+UCLASS()
+class FPSGAME_API UFPSSignificanceSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Actor must implement IFPSSignificant */
+	void Register(AActor* Actor);
+
+	/** Puts the actor back to High before forgetting it */
+	void Unregister(AActor* Actor);
+
+	EFPSSignificance GetSignificance(const AActor* Actor) const;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+protected:
+	struct FEntry
+	{
+		TWeakObjectPtr<AActor> Actor;
+		EFPSSignificance Significance;
+	};
+
+	void GatherViews();
+
+	EFPSSignificance Evaluate(const FVector& Location) const;
+
+	void SetSignificance(FEntry& Entry, EFPSSignificance NewSignificance);
+
+	TArray<FEntry> Entries;
+
+	/** Next entry to score, wraps around */
+	int32 NextEntry = 0;
+
+	/** Player view points gathered once per frame */
+	TArray<FVector> ViewLocations;
+	TArray<FVector> ViewDirections;
+};
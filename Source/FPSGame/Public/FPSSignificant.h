@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "FPSSignificant.generated.h"
+
+UENUM(BlueprintType)
+enum class EFPSSignificance : uint8
+{
+	High,
+	Medium,
+	Low,
+	Dormant
+};
+
+UINTERFACE(MinimalAPI)
+class UFPSSignificant : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Implemented by actors registered with the significance subsystem.
+ * They scale their own work (tick rate, perception, forces) down as nobody gets close to them.
+ */
+class FPSGAME_API IFPSSignificant
+{
+	GENERATED_BODY()
+
+public:
+	/** Called when the significance bucket of the actor changes, actors start out as High */
+	virtual void OnSignificanceChanged(EFPSSignificance NewSignificance) {}
+};
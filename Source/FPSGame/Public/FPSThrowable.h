@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "FPSThrowable.generated.h"
+
+UINTERFACE(MinimalAPI)
+class UFPSThrowable : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Implemented by projectiles and grenades so they can be parked in the projectile pool instead of being destroyed
+ * and flown by the batched projectile simulation without an actor.
+ */
+class FPSGAME_API IFPSThrowable
+{
+	GENERATED_BODY()
+
+public:
+	/** Called once the pool has placed and woken the actor, before it is handed out */
+	virtual void OnAcquiredFromPool() {}
+
+	/** Called before the actor is parked, reset any gameplay state here */
+	virtual void OnReturnedToPool() {}
+
+	/** Fuze length in seconds for throwables that explode on a timer, 0 if there is no fuze */
+	virtual float GetFuzeTime() const { return 0.0f; }
+
+	/** Whether a batched projectile turns into an actor on any blocking hit, or only when it hits a pawn or a physics body */
+	virtual bool MaterializeOnAnyHit() const { return true; }
+
+	/** Whether the actor makes a noise when it hits something, so the batched simulation makes one on each bounce too */
+	virtual bool MakesNoiseOnHit() const { return false; }
+
+	/**
+	 * Called when a batched projectile has been turned into this actor, RemainingFuzeTime <= 0 means the fuze ran out in flight.
+	 * The actor's life span has already been set to what the simulation had left of it.
+	 */
+	virtual void OnMaterialized(float RemainingFuzeTime) {}
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FPSVisibilityGrid.generated.h"
+
+class UBoxComponent;
+
+/**
+ * Coarse potentially visible set of a level, so sight checks between places that can never see each other skip their trace.
+ * The box is cut into cells, and for every pair of cells one bit says whether any line between them clears the static geometry.
+ * Neighbouring cells always see each other, and a pair is only hidden when every line between a grid of sample points spanning
+ * both cells is blocked, and every line between the samples of their neighbours too. This is still sampling, not an exact
+ * visibility test: an opening narrower than the sample spacing (CellSize / (SamplesPerAxis - 1)) that no sample line of either
+ * cell or their neighbours passes through is missed, and a guard looking through it at a player is culled. Keep the cells small
+ * next to slits, arrow loops and half-open doors, or leave such areas out of the grid.
+ * Baked in the editor with Build Visibility and saved with the level as a triangular bitset. A grid moved, resized or changed
+ * since its bake is not used at all, every pair counts as visible until it is baked again.
+ */
+UCLASS()
+class FPSGAME_API AFPSVisibilityGrid : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AFPSVisibilityGrid();
+
+	/** False only when the cells of From and To were baked as never seeing each other. Points outside the grid can always see */
+	bool CanSee(const FVector& From, const FVector& To) const;
+
+	/** Traces every pair of cells against the static geometry, slow on large grids, editor only */
+	UFUNCTION(CallInEditor, Category = "Visibility")
+	void BuildVisibility();
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(VisibleAnywhere, Category = "Components")
+	UBoxComponent* BoundsComp;
+
+	UPROPERTY(EditInstanceOnly, Category = "Visibility")
+	float CellSize;
+
+	/** Cells further apart than this are not traced and always count as visible, keep it above the guards' sight radius */
+	UPROPERTY(EditInstanceOnly, Category = "Visibility")
+	float MaxDistance;
+
+	/** Sample points along each axis of a cell, corners and faces included, see the class comment for what the spacing can miss */
+	UPROPERTY(EditInstanceOnly, Category = "Visibility", meta = (ClampMin = "2", ClampMax = "8"))
+	int32 SamplesPerAxis;
+
+	/** Grid the bits were baked for */
+	UPROPERTY()
+	FVector BakedOrigin;
+
+	UPROPERTY()
+	FIntVector BakedDims;
+
+	UPROPERTY()
+	float BakedCellSize;
+
+	UPROPERTY()
+	int32 BakedSamplesPerAxis;
+
+	/** One bit per unordered pair of cells, set when they may see each other */
+	UPROPERTY()
+	TArray<uint32> VisibilityBits;
+
+	bool IsUpToDate() const;
+
+	/** INDEX_NONE outside the grid */
+	int32 GetCellIndex(const FVector& Location) const;
+
+	static int64 GetPairIndex(int32 CellA, int32 CellB, int32 NumCells);
+
+	/** Whether any line between the sample points of the two cells clears the static geometry, offsets are fractions of the cell size */
+	bool TraceCells(const FIntVector& CellA, const FIntVector& CellB, const TArray<FVector>& SampleOffsets) const;
+};
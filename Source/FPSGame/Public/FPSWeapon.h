@@ -8,10 +8,10 @@
 
 class USkeletalMeshComponent;
 class USoundBase;
-class UAnimSequencebase;
+class UAnimSequenceBase;
 class UPawnNoiseEmitterComponent;
-class AFPSCharacter;
 class UBoxComponent;
+class UFPSWeaponComponent;
 
 UCLASS()
 class FPSGAME_API AFPSWeapon : public AActor
@@ -23,11 +23,13 @@ public:
 	AFPSWeapon();
 
 protected:
-	/** Sound to play each time we fire */
+	virtual void BeginPlay() override;
+
+	/** Sound to play each time we fire, deprecated: only used when the weapon data has no FireSound */
 	UPROPERTY(EditDefaultsOnly, Category="Gameplay")
 	USoundBase* FireSound;
 
-	/** AnimMontage to play each time we fire */
+	/** AnimMontage to play each time we fire, deprecated: only used when the weapon data has no FireAnimation */
 	UPROPERTY(EditDefaultsOnly, Category = "Gameplay")
 	UAnimSequenceBase* FireAnimation;
 
@@ -38,10 +40,14 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Mesh")
 	USkeletalMeshComponent* GunMeshComponent;
 
-	AFPSCharacter* MyOwner;
+	/** Fires for the character that owns this weapon, set up by its weapon data */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Weapon")
+	UFPSWeaponComponent* WeaponComponent;
 
 public:
-	void Fire();
+	void StartFire();
+
+	void StopFire();
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Collision")
 	UBoxComponent* BoxComponent;
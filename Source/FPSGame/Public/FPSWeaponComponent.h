@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
+#include "FPSWeaponComponent.generated.h"
+
+class UFPSWeaponData;
+class APawn;
+class USoundBase;
+class UAnimSequenceBase;
+
+/**
+ * Hitscan firing shared by the player character and weapon actors.
+ * Shots are scheduled from the component tick against a running next shot time, so the fire rate holds however the frame
+ * rate and the presses line up and nothing is allocated per shot. The shooter shows the shot and sends it to the server,
+ * which queues it on the hitscan subsystem.
+ */
+UCLASS(ClassGroup = (FPS), meta = (BlueprintSpawnableComponent))
+class FPSGAME_API UFPSWeaponComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UFPSWeaponComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	void StartFire();
+
+	void StopFire();
+
+	/** Uses the defaults of UFPSWeaponData when no asset is set */
+	const UFPSWeaponData* GetWeaponData() const;
+
+	/** Effects the owner set up before weapon data existed, played when the weapon data has none */
+	void SetFallbackFireEffects(USoundBase* InFireSound, UAnimSequenceBase* InFireAnimation);
+
+protected:
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
+	UFPSWeaponData* WeaponData;
+
+	UPROPERTY(Transient)
+	USoundBase* FallbackFireSound;
+
+	UPROPERTY(Transient)
+	UAnimSequenceBase* FallbackFireAnimation;
+
+	/** Shots left in the current press, MAX_int32 while an automatic weapon is held */
+	int32 ShotsLeft;
+
+	/** World time the next shot is allowed at */
+	float NextShotTime;
+
+	/** Server world time the next ServerFire is accepted at, clients don't get to pick their own fire rate */
+	float ServerNextShotTime;
+
+	/** The pawn holding this, the owner itself or the owner of a weapon actor */
+	APawn* GetShooter() const;
+
+	/** Fires every shot that is due by now */
+	void FireDueShots();
+
+	void FireShot();
+
+	/** Sound and arms animation, on the shooter's machine */
+	void PlayFireEffects(APawn* Shooter);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFire(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal TraceDirection, float ClientTime);
+	void ServerFire_Implementation(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal TraceDirection, float ClientTime);
+	bool ServerFire_Validate(FVector_NetQuantize TraceStart, FVector_NetQuantizeNormal TraceDirection, float ClientTime);
+};
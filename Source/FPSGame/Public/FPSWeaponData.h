@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Engine/EngineTypes.h"
+#include "FPSWeaponData.generated.h"
+
+class USoundBase;
+class UAnimSequenceBase;
+
+UENUM(BlueprintType)
+enum class EFPSFireMode : uint8
+{
+	/** One shot per press */
+	Single,
+	/** BurstCount shots per press */
+	Burst,
+	/** Fires for as long as the button is held */
+	Automatic
+};
+
+/** How a hitscan weapon fires, shared by every UFPSWeaponComponent that uses it */
+UCLASS(BlueprintType)
+class FPSGAME_API UFPSWeaponData : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UFPSWeaponData();
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
+	EFPSFireMode FireMode;
+
+	/** Shots per second, also the fastest Single can be clicked */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon", meta = (ClampMin = "0.1"))
+	float FireRate;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon", meta = (ClampMin = "1"))
+	int32 BurstCount;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon", meta = (ClampMin = "0"))
+	float Range;
+
+	/** Half angle in degrees of the cone shots are spread over */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon", meta = (ClampMin = "0", ClampMax = "45"))
+	float Spread;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
+	TEnumAsByte<ECollisionChannel> TraceChannel;
+
+	/** Velocity change given to what is hit */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
+	float Impulse;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "AI")
+	float NoiseLoudness;
+
+	/** Sound to play each time we fire */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Effects")
+	USoundBase* FireSound;
+
+	/** AnimMontage to play on the first person arms each time we fire */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Effects")
+	UAnimSequenceBase* FireAnimation;
+};